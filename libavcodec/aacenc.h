@@ -34,6 +34,7 @@
 
 #include "aac.h"
 #include "aacencdsp.h"
+#include "aacenctab.h"
 #include "audio_frame_queue.h"
 #include "psymodel.h"
 
@@ -213,9 +214,9 @@ typedef struct AACEncContext {
     AVClass *av_class;
     AACEncOptions options;                       ///< encoding options
     PutBitContext pb;
-    AVTXContext *mdct1024;                       ///< long (1024 samples) frame transform context
+    AVTXContext *mdct1024[AAC_MAX_CHANNELS];     ///< long (1024 samples) frame transform context, one per channel
     av_tx_fn mdct1024_fn;
-    AVTXContext *mdct128;                        ///< short (128 samples) frame transform context
+    AVTXContext *mdct128[AAC_MAX_CHANNELS];      ///< short (128 samples) frame transform context, one per channel
     av_tx_fn mdct128_fn;
     AVFloatDSPContext *fdsp;
     AACPCEInfo pce;                              ///< PCE data, if needed
@@ -120,7 +120,7 @@ typedef struct FlacEncodeContext {
     FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
-    LPCContext lpc_ctx;
+    LPCContext lpc_ctx[FLAC_MAX_CHANNELS]; ///< one per channel for slice threading
     struct AVMD5 *md5ctx;
     uint8_t *md5_buffer;
     unsigned int md5_buffer_size;
@@ -464,8 +464,12 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
         }
     }
 
-    ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
-                      s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    for (i = 0; i < channels; i++) {
+        ret = ff_lpc_init(&s->lpc_ctx[i], avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacencdsp_init(&s->flac_dsp);
@@ -1048,7 +1052,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         for (i = 0; i < n; i++)
             smp[i] = smp_33bps[i] >> 1;
 
-    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx, smp, n, min_order, max_order,
+    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx[ch], smp, n, min_order, max_order,
                                   s->options.lpc_coeff_precision, coefs, shift, s->options.lpc_type,
                                   s->options.lpc_passes, omethod,
                                   MIN_LPC_SHIFT, MAX_LPC_SHIFT, 0);
@@ -1170,6 +1174,13 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
 }
 
 
+static int encode_residual_ch_thread(AVCodecContext *avctx, void *arg,
+                                    int ch, int threadnr)
+{
+    return encode_residual_ch(avctx->priv_data, ch);
+}
+
+
 static int count_frame_header(FlacEncodeContext *s)
 {
     uint8_t av_unused tmp;
@@ -1209,12 +1220,16 @@ static int count_frame_header(FlacEncodeContext *s)
 static int encode_frame(FlacEncodeContext *s)
 {
     int ch;
+    int ch_count[FLAC_MAX_CHANNELS];
     uint64_t count;
 
     count = count_frame_header(s);
 
+    /* subframes are independent, so the channels can be searched in parallel */
+    s->avctx->execute2(s->avctx, encode_residual_ch_thread, NULL,
+                       ch_count, s->channels);
     for (ch = 0; ch < s->channels; ch++)
-        count += encode_residual_ch(s, ch);
+        count += ch_count[ch];
 
     count += (8 - (count & 7)) & 7; // byte alignment
     count += 16;                    // CRC-16
@@ -1705,7 +1720,8 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
-    ff_lpc_end(&s->lpc_ctx);
+    for (int i = 0; i < FLAC_MAX_CHANNELS; i++)
+        ff_lpc_end(&s->lpc_ctx[i]);
     return 0;
 }
 
@@ -1755,6 +1771,7 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
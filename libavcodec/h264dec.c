@@ -427,6 +427,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     ff_h264_flush_change(h);
 
+    if (h->early_output)
+        ff_thread_set_early_output(avctx);
+
     if (h->enable_er < 0 && (avctx->active_thread_type & FF_THREAD_SLICE))
         h->enable_er = 0;
 
@@ -1111,6 +1114,7 @@ static const AVOption h264_options[] = {
     { "x264_build", "Assume this x264 version if no x264 version found in any SEI", OFFSET(x264_build), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, VD },
     { "skip_gray", "Do not return gray gap frames", OFFSET(skip_gray), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, VD },
     { "noref_gray", "Avoid using gray gap frames as references", OFFSET(noref_gray), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, VD },
+    { "early_output", "Return frames as soon as they are decoded with frame threading", OFFSET(early_output), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, VD },
     { NULL },
 };
 
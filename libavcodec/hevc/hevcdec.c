@@ -34,6 +34,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/timecode.h"
 
 #include "aom_film_grain.h"
@@ -2586,6 +2587,27 @@ static int hls_decode_entry(HEVCContext *s, GetBitContext *gb)
     return ctb_addr_ts;
 }
 
+/* With frame threading, WPP rows are synchronized through per-row
+ * ThreadProgress instead of the slice thread progress API. */
+static void wpp_report_progress(const HEVCContext *s, int ctb_row, int thread, int n)
+{
+    if (s->wpp_thread) {
+        s->wpp_count[ctb_row] += n;
+        ff_thread_progress_report(&s->wpp_progress[ctb_row], s->wpp_count[ctb_row]);
+    } else
+        ff_thread_report_progress2(s->avctx, ctb_row, thread, n);
+}
+
+static void wpp_await_progress(const HEVCContext *s, int ctb_row, int thread, int shift)
+{
+    if (s->wpp_thread) {
+        if (ctb_row)
+            ff_thread_progress_await(&s->wpp_progress[ctb_row - 1],
+                                     s->wpp_count[ctb_row] + shift);
+    } else
+        ff_thread_await_progress2(s->avctx, ctb_row, thread, shift);
+}
+
 static int hls_decode_entry_wpp(AVCodecContext *avctx, void *hevc_lclist,
                                 int job, int thread)
 {
@@ -2614,13 +2636,13 @@ static int hls_decode_entry_wpp(AVCodecContext *avctx, void *hevc_lclist,
 
         hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
 
-        ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
+        wpp_await_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
 
         /* atomic_load's prototype requires a pointer to non-const atomic variable
          * (due to implementations via mutexes, where reads involve writes).
          * Of course, casting const away here is nevertheless safe. */
         if (atomic_load((atomic_int*)&s->wpp_err)) {
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
@@ -2644,19 +2666,19 @@ static int hls_decode_entry_wpp(AVCodecContext *avctx, void *hevc_lclist,
         ctb_addr_ts++;
 
         ff_hevc_save_states(lc, pps, ctb_addr_ts);
-        ff_thread_report_progress2(s->avctx, ctb_row, thread, 1);
+        wpp_report_progress(s, ctb_row, thread, 1);
         ff_hevc_hls_filters(lc, l, pps, x_ctb, y_ctb, ctb_size);
 
         if (!more_data && (x_ctb+ctb_size) < sps->width && ctb_row != s->sh.num_entry_point_offsets) {
             /* Casting const away here is safe, because it is an atomic operation. */
             atomic_store((atomic_int*)&s->wpp_err, 1);
-            ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
         if ((x_ctb+ctb_size) >= sps->width && (y_ctb+ctb_size) >= sps->height ) {
             ff_hevc_hls_filter(lc, l, pps, x_ctb, y_ctb, ctb_size);
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return ctb_addr_ts;
         }
         ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
@@ -2666,17 +2688,85 @@ static int hls_decode_entry_wpp(AVCodecContext *avctx, void *hevc_lclist,
             break;
         }
     }
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
 
     return 0;
 error:
     l->tab_slice_address[ctb_addr_rs] = -1;
     /* Casting const away here is safe, because it is an atomic operation. */
     atomic_store((atomic_int*)&s->wpp_err, 1);
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
     return ret;
 }
 
+static void wpp_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+
+    s->wpp_ret[jobnr] = hls_decode_entry_wpp(s->avctx, s->local_ctx, jobnr, threadnr);
+}
+
+static int wpp_thread_init(HEVCContext *s)
+{
+    int ret;
+
+    if (s->wpp_thread)
+        return 0;
+
+    ret = avpriv_slicethread_create(&s->wpp_thread, s, wpp_worker, NULL, s->wpp_threads);
+    if (ret < 0) {
+        av_log(s->avctx, AV_LOG_WARNING,
+               "Could not create WPP threads, decoding rows serially\n");
+        s->wpp_threads = 0;
+        return ret;
+    }
+    s->wpp_nb_threads = ret;
+
+    return 0;
+}
+
+static void wpp_rows_free(HEVCContext *s)
+{
+    for (int i = 0; i < s->nb_wpp_rows; i++)
+        ff_thread_progress_destroy(&s->wpp_progress[i]);
+    av_freep(&s->wpp_progress);
+    av_freep(&s->wpp_count);
+    s->nb_wpp_rows = 0;
+}
+
+static int wpp_rows_reset(HEVCContext *s, int nb_rows)
+{
+    int ret;
+
+    if (nb_rows > s->nb_wpp_rows) {
+        wpp_rows_free(s);
+
+        s->wpp_progress = av_calloc(nb_rows, sizeof(*s->wpp_progress));
+        s->wpp_count    = av_calloc(nb_rows, sizeof(*s->wpp_count));
+        if (!s->wpp_progress || !s->wpp_count) {
+            av_freep(&s->wpp_progress);
+            av_freep(&s->wpp_count);
+            return AVERROR(ENOMEM);
+        }
+        s->nb_wpp_rows = nb_rows;
+
+        for (int i = 0; i < nb_rows; i++) {
+            ret = ff_thread_progress_init(&s->wpp_progress[i], 1);
+            if (ret < 0) {
+                wpp_rows_free(s);
+                return ret;
+            }
+        }
+    }
+
+    for (int i = 0; i < nb_rows; i++) {
+        ff_thread_progress_reset(&s->wpp_progress[i]);
+        s->wpp_count[i] = 0;
+    }
+
+    return 0;
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const HEVCPPS *const pps = s->pps;
@@ -2686,6 +2776,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     int *ret;
     int64_t offset;
     int64_t startheader, cmpt = 0;
+    int nb_threads = s->wpp_thread ? s->wpp_nb_threads : s->avctx->thread_count;
     int i, j, res = 0;
 
     if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
@@ -2696,8 +2787,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR_INVALIDDATA;
     }
 
-    if (s->avctx->thread_count > s->nb_local_ctx) {
-        HEVCLocalContext *tmp = av_malloc_array(s->avctx->thread_count, sizeof(*s->local_ctx));
+    if (nb_threads > s->nb_local_ctx) {
+        HEVCLocalContext *tmp = av_malloc_array(nb_threads, sizeof(*s->local_ctx));
 
         if (!tmp)
             return AVERROR(ENOMEM);
@@ -2706,7 +2797,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         av_free(s->local_ctx);
         s->local_ctx = tmp;
 
-        for (unsigned i = s->nb_local_ctx; i < s->avctx->thread_count; i++) {
+        for (unsigned i = s->nb_local_ctx; i < nb_threads; i++) {
             tmp = &s->local_ctx[i];
 
             memset(tmp, 0, sizeof(*tmp));
@@ -2716,7 +2807,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
             tmp->common_cabac_state = &s->cabac;
         }
 
-        s->nb_local_ctx = s->avctx->thread_count;
+        s->nb_local_ctx = nb_threads;
     }
 
     offset = s->sh.data_offset;
@@ -2761,7 +2852,10 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     atomic_store(&s->wpp_err, 0);
-    res = ff_slice_thread_allocz_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+    if (s->wpp_thread)
+        res = wpp_rows_reset(s, s->sh.num_entry_point_offsets + 1);
+    else
+        res = ff_slice_thread_allocz_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
     if (res < 0)
         return res;
 
@@ -2769,8 +2863,14 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     if (!ret)
         return AVERROR(ENOMEM);
 
-    if (pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
+    if (pps->entropy_coding_sync_enabled_flag) {
+        if (s->wpp_thread) {
+            s->wpp_ret = ret;
+            avpriv_slicethread_execute(s->wpp_thread, s->sh.num_entry_point_offsets + 1, 0);
+            s->wpp_ret = NULL;
+        } else
+            s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -2825,10 +2925,17 @@ static int decode_slice_data(HEVCContext *s, const HEVCLayerContext *l,
     s->local_ctx[0].tu.cu_qp_offset_cb = 0;
     s->local_ctx[0].tu.cu_qp_offset_cr = 0;
 
-    if (s->avctx->active_thread_type == FF_THREAD_SLICE  &&
-        s->sh.num_entry_point_offsets > 0                &&
-        pps->num_tile_rows == 1 && pps->num_tile_columns == 1)
-        return hls_slice_data_wpp(s, nal);
+    if (s->sh.num_entry_point_offsets > 0 &&
+        pps->num_tile_rows == 1 && pps->num_tile_columns == 1) {
+        if (s->avctx->active_thread_type == FF_THREAD_SLICE)
+            return hls_slice_data_wpp(s, nal);
+        /* Rows of the frames in flight on the other frame threads can be
+         * decoded concurrently with this one's. */
+        if (s->avctx->active_thread_type == FF_THREAD_FRAME &&
+            pps->entropy_coding_sync_enabled_flag && s->wpp_threads > 1 &&
+            wpp_thread_init(s) >= 0)
+            return hls_slice_data_wpp(s, nal);
+    }
 
     return hls_decode_entry(s, gb);
 }
@@ -3563,6 +3670,9 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
 
     av_freep(&s->local_ctx);
 
+    avpriv_slicethread_free(&s->wpp_thread);
+    wpp_rows_free(s);
+
     ff_h2645_packet_uninit(&s->pkt);
 
     ff_hevc_reset_sei(&s->sei);
@@ -3754,6 +3864,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "Number of threads decoding WPP rows within each frame thread", OFFSET(wpp_threads),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_WPP_THREADS, PAR },
     { NULL },
 };
 
@@ -36,6 +36,7 @@
 #include "libavcodec/h2645_parse.h"
 #include "libavcodec/h274.h"
 #include "libavcodec/progressframe.h"
+#include "libavcodec/threadprogress.h"
 #include "libavcodec/videodsp.h"
 
 #include "dsp.h"
@@ -45,6 +46,7 @@
 #include "sei.h"
 
 #define SHIFT_CTB_WPP 2
+#define MAX_WPP_THREADS 16
 
 #define MAX_TB_SIZE 32
 #define MAX_QP 51
@@ -530,6 +532,15 @@ typedef struct HEVCContext {
 
     atomic_int wpp_err;
 
+    /** WPP row decoding inside a frame thread, see the wpp_threads option */
+    int                   wpp_threads;
+    struct AVSliceThread *wpp_thread;
+    int                   wpp_nb_threads;
+    ThreadProgress       *wpp_progress; ///< CTBs decoded per row of the slice segment
+    int                  *wpp_count;    ///< same, only accessed by the row's own job
+    int                  *wpp_ret;
+    int                nb_wpp_rows;
+
     const uint8_t *data;
 
     H2645Packet pkt;
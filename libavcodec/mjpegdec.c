@@ -56,6 +56,7 @@
 #include "exif.h"
 #include "bytestream.h"
 #include "tiff_common.h"
+#include "thread.h"
 
 
 static int init_default_huffman_tables(MJpegDecodeContext *s)
@@ -753,7 +754,7 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
         }
 
         av_frame_unref(s->picture_ptr);
-        if (ff_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
+        if (ff_thread_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
             return -1;
         s->picture_ptr->pict_type = AV_PICTURE_TYPE_I;
         s->picture_ptr->flags |= AV_FRAME_FLAG_KEY;
@@ -804,6 +805,13 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
         if (!s->hwaccel_picture_private)
             return AVERROR(ENOMEM);
 
+        /* No hwaccel calls may happen before setup is finished, so tables
+         * coded after SOF are not passed on to the next frame thread. */
+        if ((s->avctx->active_thread_type & FF_THREAD_FRAME) && !s->setup_finished) {
+            ff_thread_finish_setup(s->avctx);
+            s->setup_finished = 1;
+        }
+
         ret = hwaccel->start_frame(s->avctx, s->raw_image_buffer,
                                    s->raw_image_buffer_size);
         if (ret < 0)
@@ -2367,6 +2375,32 @@ static void reset_icc_profile(MJpegDecodeContext *s)
     s->iccnum  = 0;
 }
 
+/* Check whether the scan starting at buf is followed by nothing but restart
+ * markers and EOI, i.e. whether it is the last thing parsed in the packet. */
+static int scan_ends_picture(const MJpegDecodeContext *s,
+                             const uint8_t *buf, const uint8_t *buf_end)
+{
+    /* THP scans extend up to the end of the packet */
+    if (s->avctx->codec_id == AV_CODEC_ID_THP)
+        return 1;
+    if (buf_end - buf < 2)
+        return 0;
+    buf += AV_RB16(buf);
+
+    while (buf_end - buf >= 2) {
+        const uint8_t *ptr = memchr(buf, 0xff, buf_end - buf - 1);
+        int x;
+
+        if (!ptr)
+            break;
+        x = ptr[1];
+        if (x && x != 0xff && (x < RST0 || x > RST7))
+            return x == EOI;
+        buf = ptr + 1;
+    }
+    return 0;
+}
+
 int ff_mjpeg_decode_frame_from_buf(AVCodecContext *avctx, AVFrame *frame,
                                    int *got_frame, const AVPacket *avpkt,
                                    const uint8_t *buf, const int buf_size)
@@ -2383,6 +2417,7 @@ int ff_mjpeg_decode_frame_from_buf(AVCodecContext *avctx, AVFrame *frame,
     AVDictionaryEntry *e = NULL;
 
     s->force_pal8 = 0;
+    s->setup_finished = 0;
 
     s->buf_size = buf_size;
 
@@ -2579,9 +2614,26 @@ eoi_parser:
                 break;
             }
 
+            /* A scan containing all components that is followed only by
+             * EOI completes a sequential picture, so the next frame thread
+             * can start before it is decoded. */
+            if ((avctx->active_thread_type & FF_THREAD_FRAME) &&
+                !s->setup_finished && !avctx->hwaccel &&
+                !s->progressive && !s->ls && !s->interlaced &&
+                (show_bits(&s->gb, 24) & 0xFF) == s->nb_components &&
+                scan_ends_picture(s, buf_ptr, buf_end)) {
+                ff_thread_finish_setup(avctx);
+                s->setup_finished = 1;
+            }
+
             if ((ret = ff_mjpeg_decode_sos(s, NULL, 0, NULL)) < 0 &&
                 (avctx->err_recognition & AV_EF_EXPLODE))
                 goto fail;
+
+            if (s->setup_finished && !avctx->hwaccel) {
+                buf_ptr += (get_bits_count(&s->gb) + 7) / 8;
+                goto eoi_parser;
+            }
             break;
         case DRI:
             if ((ret = mjpeg_decode_dri(s)) < 0)
@@ -2980,6 +3032,101 @@ static void decode_flush(AVCodecContext *avctx)
     av_frame_unref(s->smv_frame);
 }
 
+#if HAVE_THREADS && (CONFIG_MJPEG_DECODER || CONFIG_THP_DECODER)
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    MJpegDecodeContext *s = dst->priv_data;
+    const MJpegDecodeContext *ssrc = src->priv_data;
+    int ret;
+
+    if (dst == src)
+        return 0;
+
+    /* With a hwaccel, setup is finished at SOF while tables may still be
+     * parsed by the source thread, so keep the state of this thread. */
+    if (ssrc->hwaccel_pix_fmt != ssrc->hwaccel_sw_pix_fmt)
+        return 0;
+
+    for (int class = 0; class < 2; class++) {
+        for (int index = 0; index < 4; index++) {
+            uint8_t bits_table[17] = { 0 };
+
+            if (!memcmp(s->raw_huffman_lengths[class][index],
+                        ssrc->raw_huffman_lengths[class][index], 16) &&
+                !memcmp(s->raw_huffman_values[class][index],
+                        ssrc->raw_huffman_values[class][index], 256))
+                continue;
+
+            memcpy(s->raw_huffman_lengths[class][index],
+                   ssrc->raw_huffman_lengths[class][index], 16);
+            memcpy(s->raw_huffman_values[class][index],
+                   ssrc->raw_huffman_values[class][index], 256);
+            memcpy(bits_table + 1, s->raw_huffman_lengths[class][index], 16);
+
+            ff_vlc_free(&s->vlcs[class][index]);
+            ret = ff_mjpeg_build_vlc(&s->vlcs[class][index], bits_table,
+                                     s->raw_huffman_values[class][index],
+                                     class > 0, dst);
+            if (ret < 0)
+                return ret;
+
+            if (class > 0) {
+                ff_vlc_free(&s->vlcs[2][index]);
+                ret = ff_mjpeg_build_vlc(&s->vlcs[2][index], bits_table,
+                                         s->raw_huffman_values[class][index],
+                                         0, dst);
+                if (ret < 0)
+                    return ret;
+            }
+        }
+    }
+
+    memcpy(s->quant_matrixes, ssrc->quant_matrixes, sizeof(s->quant_matrixes));
+    memcpy(s->qscale,         ssrc->qscale,         sizeof(s->qscale));
+
+    if (s->bits != ssrc->bits)
+        init_idct(dst);
+
+    s->width         = ssrc->width;
+    s->height        = ssrc->height;
+    s->bits          = ssrc->bits;
+    memcpy(s->h_count, ssrc->h_count, sizeof(s->h_count));
+    memcpy(s->v_count, ssrc->v_count, sizeof(s->v_count));
+    s->first_picture = ssrc->first_picture;
+    s->interlaced    = ssrc->interlaced;
+
+    s->buggy_avid         = ssrc->buggy_avid;
+    s->cs_itu601          = ssrc->cs_itu601;
+    s->flipped            = ssrc->flipped;
+    s->interlace_polarity = ssrc->interlace_polarity;
+    s->multiscope         = ssrc->multiscope;
+
+    s->hwaccel_pix_fmt    = ssrc->hwaccel_pix_fmt;
+    s->hwaccel_sw_pix_fmt = ssrc->hwaccel_sw_pix_fmt;
+
+    /* If setup was finished early, the source thread is still decoding a
+     * complete picture; otherwise it may have left the first field of an
+     * interlaced picture for this thread to complete. */
+    if (ssrc->setup_finished)
+        return 0;
+
+    s->bottom_field = ssrc->bottom_field;
+    s->got_picture  = ssrc->got_picture;
+    if (s->got_picture && s->interlaced) {
+        ret = av_frame_replace(s->picture_ptr, ssrc->picture_ptr);
+        if (ret < 0)
+            return ret;
+
+        s->nb_components = ssrc->nb_components;
+        s->rgb           = ssrc->rgb;
+        s->pix_desc      = ssrc->pix_desc;
+        memcpy(s->linesize, ssrc->linesize, sizeof(s->linesize));
+    }
+
+    return 0;
+}
+#endif
+
 #if CONFIG_MJPEG_DECODER
 #define OFFSET(x) offsetof(MJpegDecodeContext, x)
 #define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
@@ -3006,7 +3153,8 @@ const FFCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     FF_CODEC_DECODE_CB(ff_mjpeg_decode_frame),
     .flush          = decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1,
+    UPDATE_THREAD_CONTEXT(update_thread_context),
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
     .p.max_lowres   = 3,
     .p.priv_class   = &mjpegdec_class,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
@@ -3035,7 +3183,8 @@ const FFCodec ff_thp_decoder = {
     .close          = ff_mjpeg_decode_end,
     FF_CODEC_DECODE_CB(ff_mjpeg_decode_frame),
     .flush          = decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1,
+    UPDATE_THREAD_CONTEXT(update_thread_context),
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
     .p.max_lowres   = 3,
     .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -383,35 +383,64 @@ static int bands_dist(OpusPsyContext *s, CeltFrame *f, float *total_dist)
     return 0;
 }
 
+typedef struct TrialSearch {
+    OpusPsyContext *s;
+    const CeltFrame *f;
+    int first_band;   /* intensity stereo band of the first job */
+    int dual_stereo;  /* -1 to try both dual stereo settings */
+    float dist[CELT_MAX_BANDS + 1];
+} TrialSearch;
+
+/* Every trial starts from a private copy of the frame, so that the result
+ * does not depend on the order in which the trials run. */
+static int trial_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    TrialSearch *t = arg;
+    CeltFrame *f = &t->s->trial_frames[threadnr];
+    struct CeltPVQ *pvq = f->pvq;
+
+    *f = *t->f;
+    f->pvq = pvq;
+    if (t->dual_stereo < 0) {
+        f->dual_stereo = jobnr;
+    } else {
+        f->dual_stereo      = t->dual_stereo;
+        f->intensity_stereo = t->first_band - jobnr;
+    }
+
+    return bands_dist(t->s, f, &t->dist[jobnr]);
+}
+
 static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
 {
-    float td1, td2;
+    TrialSearch t = { .s = s, .f = f, .dual_stereo = -1 };
     f->dual_stereo = 0;
 
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
-    bands_dist(s, f, &td1);
-    f->dual_stereo = 1;
-    bands_dist(s, f, &td2);
+    s->avctx->execute2(s->avctx, trial_job, &t, NULL, 2);
 
-    f->dual_stereo = td2 < td1;
-    s->dual_stereo_used += td2 < td1;
+    f->dual_stereo = t.dist[1] < t.dist[0];
+    s->dual_stereo_used += t.dist[1] < t.dist[0];
 }
 
 static void celt_search_for_intensity(OpusPsyContext *s, CeltFrame *f)
 {
+    TrialSearch t = { .s = s, .f = f, .first_band = f->end_band,
+                      .dual_stereo = f->dual_stereo };
     int i, best_band = CELT_MAX_BANDS - 1;
-    float dist, best_dist = FLT_MAX;
+    float best_dist = FLT_MAX;
     /* TODO: fix, make some heuristic up here using the lambda value */
-    float end_band = 0;
+    int end_band = 0;
 
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
+    s->avctx->execute2(s->avctx, trial_job, &t, NULL, f->end_band - end_band + 1);
+
     for (i = f->end_band; i >= end_band; i--) {
-        f->intensity_stereo = i;
-        bands_dist(s, f, &dist);
+        const float dist = t.dist[f->end_band - i];
         if (best_dist > dist) {
             best_dist = dist;
             best_band = i;
@@ -513,6 +542,14 @@ void ff_opus_psy_postencode_update(OpusPsyContext *s, CeltFrame *f)
     s->inflection_points_count = 0;
 }
 
+static av_cold void free_trial_frames(OpusPsyContext *s)
+{
+    for (int i = 0; i < s->nb_trial_frames; i++)
+        ff_celt_pvq_uninit(&s->trial_frames[i].pvq);
+    av_freep(&s->trial_frames);
+    s->nb_trial_frames = 0;
+}
+
 av_cold int ff_opus_psy_init(OpusPsyContext *s, AVCodecContext *avctx,
                              struct FFBufQueue *bufqueue, OpusEncOptions *options)
 {
@@ -570,9 +607,26 @@ av_cold int ff_opus_psy_init(OpusPsyContext *s, AVCodecContext *avctx,
             goto fail;
     }
 
+    /* The stereo searches run their trials on slice threads */
+    if (s->avctx->ch_layout.nb_channels == 2) {
+        const int nb_threads = FFMAX(avctx->thread_count, 1);
+
+        s->trial_frames = av_calloc(nb_threads, sizeof(*s->trial_frames));
+        if (!s->trial_frames) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < nb_threads; i++) {
+            s->nb_trial_frames++;
+            if ((ret = ff_celt_pvq_init(&s->trial_frames[i].pvq, 1)) < 0)
+                goto fail;
+        }
+    }
+
     return 0;
 
 fail:
+    free_trial_frames(s);
     av_freep(&s->inflection_points);
     av_freep(&s->dsp);
 
@@ -607,6 +661,8 @@ av_cold int ff_opus_psy_end(OpusPsyContext *s)
     for (i = 0; i < s->max_steps; i++)
         av_freep(&s->steps[i]);
 
+    free_trial_frames(s);
+
     av_log(s->avctx, AV_LOG_INFO, "Average Intensity Stereo band: %0.1f\n", s->avg_is_band);
     av_log(s->avctx, AV_LOG_INFO, "Dual Stereo used: %0.2f%%\n", ((float)s->dual_stereo_used/s->total_packets_out)*100.0f);
 
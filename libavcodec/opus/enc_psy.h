@@ -69,6 +69,10 @@ typedef struct OpusPsyContext {
 
     DECLARE_ALIGNED(32, float, scratch)[2048];
 
+    /* Per-thread copies of the frame used for the stereo searches */
+    CeltFrame *trial_frames;
+    int nb_trial_frames;
+
     /* Stats */
     float avg_is_band;
     int64_t dual_stereo_used;
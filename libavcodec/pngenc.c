@@ -50,6 +50,13 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+typedef struct PNGDeflateChunk {
+    uint8_t *data;
+    int size;
+    uLong adler;                 ///< Adler-32 of the uncompressed chunk
+    int ret;
+} PNGDeflateChunk;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -64,6 +71,16 @@ typedef struct PNGEncContext {
     uint8_t buf[IOBUF_SIZE];
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
+    int compression_level;
+
+    // Chunked deflate
+    int deflate_chunk_size;      ///< Input size of independently deflated chunks, 0 if disabled
+    FFZStream *chunk_zstreams;   ///< raw deflate streams, one per thread
+    int nb_chunk_zstreams;
+    uint8_t *filtered_buf;
+    unsigned int filtered_buf_size;
+    PNGDeflateChunk *chunks;
+    unsigned int chunks_size;
 
     int is_progressive;
     int bit_depth;
@@ -506,6 +523,150 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+typedef struct PNGChunkContext {
+    const AVFrame *frame;
+    int row_size;
+    int chunk_rows;
+    int nb_chunks;
+    uint8_t *crow_base;
+    size_t crow_stride;
+    uint8_t *filtered;           ///< filtered rows, each prefixed by its filter type
+    size_t chunk_bound;
+    PNGDeflateChunk *chunks;
+} PNGChunkContext;
+
+static int filter_chunk(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s      = avctx->priv_data;
+    PNGChunkContext *c    = arg;
+    const AVFrame *p      = c->frame;
+    const size_t stride   = c->row_size + 1;
+    // pixel data should be aligned, but there's a control byte before it
+    uint8_t *crow_buf     = c->crow_base + threadnr * c->crow_stride + 15;
+    const int y_start     = jobnr * c->chunk_rows;
+    const int y_end       = FFMIN(y_start + c->chunk_rows, p->height);
+
+    for (int y = y_start; y < y_end; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        const uint8_t *top = y ? ptr - p->linesize[0] : NULL;
+        const uint8_t *crow = png_choose_filter(s, crow_buf, ptr, top,
+                                                c->row_size, s->bits_per_pixel >> 3);
+        memcpy(c->filtered + y * stride, crow, stride);
+    }
+    return 0;
+}
+
+/* The first chunk goes through the regular zlib stream to get the header,
+ * the others through raw streams primed with the preceding 32 KiB of input.
+ * All but the last chunk end with a sync flush, so that they can simply be
+ * concatenated. */
+static int deflate_chunk(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    PNGChunkContext *c     = arg;
+    PNGDeflateChunk *chunk = &c->chunks[jobnr];
+    z_stream *const zstream = jobnr ? &s->chunk_zstreams[threadnr].zstream
+                                    : &s->zstream.zstream;
+    const size_t stride    = c->row_size + 1;
+    const int last         = jobnr == c->nb_chunks - 1;
+    const int y_start      = jobnr * c->chunk_rows;
+    const int rows         = FFMIN(c->chunk_rows, c->frame->height - y_start);
+    const uint8_t *src     = c->filtered + y_start * stride;
+    int ret;
+
+    chunk->ret = AVERROR_EXTERNAL;
+    if (jobnr) {
+        const int dict_size = FFMIN(y_start * stride, 1 << MAX_WBITS);
+        deflateReset(zstream);
+        if (deflateSetDictionary(zstream, src - dict_size, dict_size) != Z_OK)
+            return chunk->ret;
+    }
+
+    chunk->data = c->filtered + c->frame->height * stride + jobnr * c->chunk_bound;
+    zstream->next_in   = src;
+    zstream->avail_in  = rows * stride;
+    zstream->next_out  = chunk->data;
+    zstream->avail_out = c->chunk_bound;
+    ret = deflate(zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK) || zstream->avail_in)
+        return chunk->ret;
+
+    chunk->size  = c->chunk_bound - zstream->avail_out;
+    chunk->adler = adler32(adler32(0, NULL, 0), src, rows * stride);
+    return chunk->ret = 0;
+}
+
+static int encode_frame_chunked(AVCodecContext *avctx, const AVFrame *pict,
+                                int chunk_rows)
+{
+    PNGEncContext *s = avctx->priv_data;
+    const int nb_threads = FFMAX(avctx->thread_count, 1);
+    PNGChunkContext c = {
+        .frame      = pict,
+        .row_size   = (pict->width * s->bits_per_pixel + 7) >> 3,
+        .chunk_rows = chunk_rows,
+        .nb_chunks  = (pict->height + chunk_rows - 1) / chunk_rows,
+    };
+    const size_t stride = c.row_size + 1;
+    uLong adler = adler32(0, NULL, 0);
+    size_t size;
+    int ret;
+
+    if (!s->chunk_zstreams) {
+        s->chunk_zstreams = av_calloc(nb_threads, sizeof(*s->chunk_zstreams));
+        if (!s->chunk_zstreams)
+            return AVERROR(ENOMEM);
+        s->nb_chunk_zstreams = nb_threads;
+        for (int i = 0; i < nb_threads; i++) {
+            ret = ff_deflate_init2(&s->chunk_zstreams[i], s->compression_level,
+                                   -MAX_WBITS, avctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    /* room for the sync flush marker and the Adler-32 trailer */
+    c.chunk_bound = deflateBound(&s->zstream.zstream, chunk_rows * stride) + 16;
+    size = pict->height * stride + c.nb_chunks * c.chunk_bound;
+    if (size > UINT_MAX)
+        return AVERROR(EINVAL);
+    av_fast_malloc(&s->filtered_buf, &s->filtered_buf_size, size);
+    av_fast_malloc(&s->chunks, &s->chunks_size, c.nb_chunks * sizeof(*s->chunks));
+    if (!s->filtered_buf || !s->chunks)
+        return AVERROR(ENOMEM);
+    c.filtered = s->filtered_buf;
+    c.chunks   = s->chunks;
+
+    c.crow_stride = FFALIGN((c.row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED), 64);
+    c.crow_base   = av_malloc_array(nb_threads, c.crow_stride);
+    if (!c.crow_base)
+        return AVERROR(ENOMEM);
+
+    avctx->execute2(avctx, filter_chunk, &c, NULL, c.nb_chunks);
+    avctx->execute2(avctx, deflate_chunk, &c, NULL, c.nb_chunks);
+    av_freep(&c.crow_base);
+    deflateReset(&s->zstream.zstream);
+
+    for (int i = 0; i < c.nb_chunks; i++) {
+        PNGDeflateChunk *const chunk = &c.chunks[i];
+        const int rows = FFMIN(chunk_rows, pict->height - i * chunk_rows);
+
+        if (chunk->ret < 0)
+            return chunk->ret;
+
+        adler = adler32_combine(adler, chunk->adler, rows * stride);
+        if (i == c.nb_chunks - 1) {
+            AV_WB32(chunk->data + chunk->size, adler);
+            chunk->size += 4;
+        }
+        if (s->bytestream_end - s->bytestream <= chunk->size + 100)
+            return AVERROR_BUG;
+        png_write_image_data(avctx, chunk->data, chunk->size);
+    }
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -520,6 +681,12 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (s->deflate_chunk_size && !s->is_progressive) {
+        const int chunk_rows = FFMAX(s->deflate_chunk_size / (row_size + 1), 1);
+        if (pict->height > chunk_rows)
+            return encode_frame_chunked(avctx, pict, chunk_rows);
+    }
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1103,7 +1270,6 @@ static int encode_apng(AVCodecContext *avctx, AVPacket *pkt,
 static av_cold int png_enc_init(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
-    int compression_level;
 
     switch (avctx->pix_fmt) {
     case AV_PIX_FMT_RGBA:
@@ -1181,10 +1347,10 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     }
     s->bits_per_pixel = ff_png_get_nb_channels(s->color_type) * s->bit_depth;
 
-    compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
-                      ? Z_DEFAULT_COMPRESSION
-                      : av_clip(avctx->compression_level, 0, 9);
-    return ff_deflate_init(&s->zstream, compression_level, avctx);
+    s->compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
+                         ? Z_DEFAULT_COMPRESSION
+                         : av_clip(avctx->compression_level, 0, 9);
+    return ff_deflate_init(&s->zstream, s->compression_level, avctx);
 }
 
 static av_cold int png_enc_close(AVCodecContext *avctx)
@@ -1192,6 +1358,12 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    for (int i = 0; i < s->nb_chunk_zstreams; i++)
+        ff_deflate_end(&s->chunk_zstreams[i]);
+    av_freep(&s->chunk_zstreams);
+    s->nb_chunk_zstreams = 0;
+    av_freep(&s->filtered_buf);
+    av_freep(&s->chunks);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1212,6 +1384,7 @@ static const AVOption options[] = {
         { "avg",   NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_AVG },   INT_MIN, INT_MAX, VE, .unit = "pred" },
         { "paeth", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_PAETH }, INT_MIN, INT_MAX, VE, .unit = "pred" },
         { "mixed", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = PNG_FILTER_VALUE_MIXED }, INT_MIN, INT_MAX, VE, .unit = "pred" },
+    { "deflate_chunk_size", "Compress the image data in independent chunks of this many bytes", OFFSET(deflate_chunk_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1 << 30, VE },
     { NULL},
 };
 
@@ -1228,6 +1401,7 @@ const FFCodec ff_png_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_PNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1251,6 +1425,7 @@ const FFCodec ff_apng_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_APNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -149,6 +149,13 @@ typedef struct FrameThreadContext {
 
     int next_decoding;             ///< The next context to submit a packet to.
     int next_finished;             ///< The next context to return output from.
+    int nb_pending;                ///< Number of contexts whose output has not been returned yet.
+
+    /**
+     * Return the output of the next_finished context as soon as it is done,
+     * see ff_thread_set_early_output().
+     */
+    int early_output;
 
     /* hwaccel state for thread-unsafe hwaccels is temporarily stored here in
      * order to transfer its ownership to the next decoding thread without the
@@ -573,26 +580,32 @@ int ff_thread_receive_frame(AVCodecContext *avctx, AVFrame *frame)
 
     /* submit packets to threads while there are no buffered results to return */
     while (!fctx->df.nb_f && !fctx->result) {
-        PerThreadContext *p;
+        PerThreadContext *p = &fctx->threads[fctx->next_finished];
 
         /* get a packet to be submitted to the next thread */
         av_packet_unref(fctx->next_pkt);
         ret = ff_decode_get_packet(avctx, fctx->next_pkt);
-        if (ret < 0 && ret != AVERROR_EOF)
+        if (ret >= 0 || ret == AVERROR_EOF) {
+            ret = submit_packet(&fctx->threads[fctx->next_decoding], avctx,
+                                fctx->next_pkt);
+            if (ret < 0)
+                 goto finish;
+            fctx->nb_pending++;
+
+            /* do not return any frames until all threads have something to do */
+            if (fctx->next_decoding != fctx->next_finished &&
+                !avctx->internal->draining)
+                continue;
+        } else if (ret != AVERROR(EAGAIN) || !fctx->early_output ||
+                   !fctx->nb_pending ||
+                   atomic_load(&p->state) != STATE_INPUT_READY) {
             goto finish;
+        }
+        /* in early output mode, the oldest frame is returned as soon as it is
+         * done and no more input is available, even if some threads are idle */
 
-        ret = submit_packet(&fctx->threads[fctx->next_decoding], avctx,
-                            fctx->next_pkt);
-        if (ret < 0)
-             goto finish;
-
-        /* do not return any frames until all threads have something to do */
-        if (fctx->next_decoding != fctx->next_finished &&
-            !avctx->internal->draining)
-            continue;
-
-        p                   = &fctx->threads[fctx->next_finished];
         fctx->next_finished = (fctx->next_finished + 1) % avctx->thread_count;
+        fctx->nb_pending--;
 
         if (atomic_load(&p->state) != STATE_INPUT_READY) {
             pthread_mutex_lock(&p->progress_mutex);
@@ -667,6 +680,17 @@ void ff_thread_await_progress(const ThreadFrame *f, int n, int field)
     pthread_mutex_unlock(&p->progress_mutex);
 }
 
+void ff_thread_set_early_output(AVCodecContext *avctx)
+{
+    PerThreadContext *p;
+
+    if (!(avctx->active_thread_type & FF_THREAD_FRAME))
+        return;
+
+    p = avctx->internal->thread_ctx;
+    p->parent->early_output = 1;
+}
+
 void ff_thread_finish_setup(AVCodecContext *avctx) {
     PerThreadContext *p;
 
@@ -992,6 +1016,7 @@ void ff_thread_flush(AVCodecContext *avctx)
     }
 
     fctx->next_decoding = fctx->next_finished = 0;
+    fctx->nb_pending = 0;
     fctx->prev_thread = NULL;
 
     decoded_frames_flush(&fctx->df);
@@ -43,6 +43,18 @@ int ff_thread_can_start_frame(AVCodecContext *avctx);
  */
 void ff_thread_finish_setup(AVCodecContext *avctx);
 
+/**
+ * Return each decoded frame from the frame threading layer as soon as the
+ * thread decoding it has finished and no further packet is available,
+ * instead of only once every thread has been given a packet. This removes
+ * up to thread_count - 1 frames of delay for codecs whose frames depend on
+ * each other only through row progress.
+ * Must be called from the codec's init function.
+ *
+ * @param avctx The context.
+ */
+void ff_thread_set_early_output(AVCodecContext *avctx);
+
 /**
  * Wrapper around get_buffer() for frame-multithreaded codecs.
  * Call this function instead of ff_get_buffer(f).
@@ -100,4 +100,32 @@ H2656_MC_8TAP_PROTOTYPES_AVX2(4tap_h);
 H2656_MC_8TAP_PROTOTYPES_AVX2(4tap_v);
 H2656_MC_8TAP_PROTOTYPES_AVX2(4tap_hv);
 
+#define H2656_SAO_BAND_FILTER_PROTOTYPE(w, bitd, opt) \
+void ff_h2656_sao_band_filter_##w##_##bitd##_##opt(uint8_t *_dst, const uint8_t *_src, ptrdiff_t _stride_dst, ptrdiff_t _stride_src, \
+                                                   const int16_t *sao_offset_val, int sao_left_class, int width, int height)
+
+#define H2656_SAO_BAND_FILTER_PROTOTYPES(bitd, opt)   \
+    H2656_SAO_BAND_FILTER_PROTOTYPE( 8, bitd, opt);   \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(16, bitd, opt);   \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(32, bitd, opt);   \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(48, bitd, opt);   \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(64, bitd, opt)
+
+#define H2656_SAO_BAND_FILTER_PROTOTYPES_AVX2(bitd)   \
+    H2656_SAO_BAND_FILTER_PROTOTYPES(bitd, avx2);     \
+    H2656_SAO_BAND_FILTER_PROTOTYPE( 80, bitd, avx2); \
+    H2656_SAO_BAND_FILTER_PROTOTYPE( 96, bitd, avx2); \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(112, bitd, avx2); \
+    H2656_SAO_BAND_FILTER_PROTOTYPE(128, bitd, avx2)
+
+H2656_SAO_BAND_FILTER_PROTOTYPES( 8, sse2);
+H2656_SAO_BAND_FILTER_PROTOTYPES(10, sse2);
+H2656_SAO_BAND_FILTER_PROTOTYPES(12, sse2);
+H2656_SAO_BAND_FILTER_PROTOTYPES( 8, avx);
+H2656_SAO_BAND_FILTER_PROTOTYPES(10, avx);
+H2656_SAO_BAND_FILTER_PROTOTYPES(12, avx);
+H2656_SAO_BAND_FILTER_PROTOTYPES_AVX2( 8);
+H2656_SAO_BAND_FILTER_PROTOTYPES_AVX2(10);
+H2656_SAO_BAND_FILTER_PROTOTYPES_AVX2(12);
+
 #endif
@@ -0,0 +1,115 @@
+; /*
+; * Provide SIMD LMCS functions for VVC decoding
+; *
+; * This file is part of FFmpeg.
+; *
+; * FFmpeg is free software; you can redistribute it and/or
+; * modify it under the terms of the GNU Lesser General Public
+; * License as published by the Free Software Foundation; either
+; * version 2.1 of the License, or (at your option) any later version.
+; *
+; * FFmpeg is distributed in the hope that it will be useful,
+; * but WITHOUT ANY WARRANTY; without even the implied warranty of
+; * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+; * Lesser General Public License for more details.
+; *
+; * You should have received a copy of the GNU Lesser General Public
+; * License along with FFmpeg; if not, write to the Free Software
+; * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+; */
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_255: times 8 dd 255
+
+cextern pd_65535
+
+SECTION .text
+
+; The lookup is done with 32 bit gathers, so up to 3 bytes past the last
+; addressed LUT entry may be read. The LUT is embedded in VVCLMCS, which has
+; enough trailing members to cover that.
+
+%if ARCH_X86_64
+%if HAVE_AVX2_EXTERNAL
+
+; %1: bpc, %2: register holding the mask, %3: register holding the pixels, %4: scratch
+%macro LMCS_LOOKUP 4
+    pcmpeqd          %4, %4
+%if %1 == 8
+    vpgatherdd       %3, [lutq + %2], %4
+%else
+    vpgatherdd       %3, [lutq + %2 * 2], %4
+%endif
+%endmacro
+
+; void ff_vvc_lmcs_filter_luma_<bd>_avx2(uint8_t *dst, ptrdiff_t dst_stride, int width, int height, const void *lut)
+%macro LMCS_FILTER_LUMA 2 ; bpc, bit_depth
+cglobal vvc_lmcs_filter_luma_%2, 5, 7, 4, dst, dst_stride, w, h, lut, x, tmp
+    movsxdifnidn     wq, wd
+%if %1 == 8
+    mova             m3, [pd_255]
+%else
+    mova             m3, [pd_65535]
+%endif
+
+.loop_h:
+    xor              xq, xq
+    cmp              wq, 8
+    jl .w4
+
+.loop_w:
+%if %1 == 8
+    pmovzxbd         m0, [dstq + xq]
+%else
+    pmovzxwd         m0, [dstq + xq * 2]
+%endif
+    LMCS_LOOKUP      %1, m0, m1, m2
+    pand             m1, m3
+    packusdw         m1, m1
+    vpermq           m1, m1, q2020
+%if %1 == 8
+    packuswb        xm1, xm1
+    movq   [dstq + xq], xm1
+%else
+    movu [dstq + xq * 2], xm1
+%endif
+    add              xq, 8
+    lea            tmpq, [xq + 8]
+    cmp            tmpq, wq
+    jle .loop_w
+    cmp              xq, wq
+    je .next_row
+
+.w4:
+%if %1 == 8
+    pmovzxbd        xm0, [dstq + xq]
+%else
+    pmovzxwd        xm0, [dstq + xq * 2]
+%endif
+    LMCS_LOOKUP      %1, xm0, xm1, xm2
+    pand            xm1, xm3
+    packusdw        xm1, xm1
+%if %1 == 8
+    packuswb        xm1, xm1
+    movd   [dstq + xq], xm1
+%else
+    movq [dstq + xq * 2], xm1
+%endif
+
+.next_row:
+    add            dstq, dst_strideq
+    dec              hd
+    jg .loop_h
+    RET
+%endmacro
+
+INIT_YMM avx2
+LMCS_FILTER_LUMA  8,  8
+LMCS_FILTER_LUMA 16, 10
+LMCS_FILTER_LUMA 16, 12
+
+%endif ; HAVE_AVX2_EXTERNAL
+%endif ; ARCH_X86_64
@@ -0,0 +1,186 @@
+; /*
+; * Provide SIMD residual reconstruction functions for VVC decoding
+; *
+; * This file is part of FFmpeg.
+; *
+; * FFmpeg is free software; you can redistribute it and/or
+; * modify it under the terms of the GNU Lesser General Public
+; * License as published by the Free Software Foundation; either
+; * version 2.1 of the License, or (at your option) any later version.
+; *
+; * FFmpeg is distributed in the hope that it will be useful,
+; * but WITHOUT ANY WARRANTY; without even the implied warranty of
+; * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+; * Lesser General Public License for more details.
+; *
+; * You should have received a copy of the GNU Lesser General Public
+; * License along with FFmpeg; if not, write to the Free Software
+; * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+; */
+
+%include "libavutil/x86/x86util.asm"
+
+cextern pw_1023
+cextern pw_4095
+
+SECTION .text
+
+; The residuals are 32 bit, they are saturated to 16 bit before being added to
+; the prediction. This does not change the result after clipping to the pixel
+; range, since the prediction itself is at most 12 bits.
+
+%if ARCH_X86_64
+%if HAVE_AVX2_EXTERNAL
+
+INIT_YMM avx2
+
+; void ff_vvc_add_residual_8_avx2(uint8_t *dst, const int *res, int width, int height, ptrdiff_t stride)
+cglobal vvc_add_residual_8, 5, 6, 3, dst, res, w, h, stride, x
+    movsxdifnidn     wq, wd
+    cmp              wd, 8
+    jg .w16
+    je .w8
+    cmp              wd, 4
+    je .w4
+
+.w2:
+    movq            xm0, [resq]
+    movzx            xd, word [dstq]
+    movd            xm1, xd
+    packssdw        xm0, xm0
+    pmovzxbw        xm1, xm1
+    paddsw          xm0, xm1
+    packuswb        xm0, xm0
+    movd             xd, xm0
+    mov          [dstq], xw
+    add            resq, 2 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w2
+    RET
+
+.w4:
+    movu            xm0, [resq]
+    movd            xm1, [dstq]
+    packssdw        xm0, xm0
+    pmovzxbw        xm1, xm1
+    paddsw          xm0, xm1
+    packuswb        xm0, xm0
+    movd         [dstq], xm0
+    add            resq, 4 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w4
+    RET
+
+.w8:
+    movu             m0, [resq]
+    pmovzxbw        xm1, [dstq]
+    vextracti128    xm2, m0, 1
+    packssdw        xm0, xm2
+    paddsw          xm0, xm1
+    packuswb        xm0, xm0
+    movq         [dstq], xm0
+    add            resq, 8 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w8
+    RET
+
+.w16:
+    xor              xq, xq
+.w16_loop:
+    movu             m0, [resq]
+    packssdw         m0, [resq + 32]
+    pmovzxbw         m1, [dstq + xq]
+    vpermq           m0, m0, q3120
+    paddsw           m0, m1
+    packuswb         m0, m0
+    vpermq           m0, m0, q2020
+    movu   [dstq + xq], xm0
+    add            resq, 16 * 4
+    add              xq, 16
+    cmp              xq, wq
+    jl .w16_loop
+    add            dstq, strideq
+    dec              hd
+    jg .w16
+    RET
+
+; void ff_vvc_add_residual_<bd>_avx2(uint8_t *dst, const int *res, int width, int height, ptrdiff_t stride)
+%macro ADD_RESIDUAL_16BPC 2 ; bit_depth, pixel_max
+cglobal vvc_add_residual_%1, 5, 6, 4, dst, res, w, h, stride, x
+    movsxdifnidn     wq, wd
+    pxor             m2, m2
+    mova             m3, [pw_%2]
+    cmp              wd, 8
+    jg .w16
+    je .w8
+    cmp              wd, 4
+    je .w4
+
+.w2:
+    movq            xm0, [resq]
+    movd            xm1, [dstq]
+    packssdw        xm0, xm0
+    paddsw          xm0, xm1
+    CLIPW           xm0, xm2, xm3
+    movd         [dstq], xm0
+    add            resq, 2 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w2
+    RET
+
+.w4:
+    movu            xm0, [resq]
+    movq            xm1, [dstq]
+    packssdw        xm0, xm0
+    paddsw          xm0, xm1
+    CLIPW           xm0, xm2, xm3
+    movq         [dstq], xm0
+    add            resq, 4 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w4
+    RET
+
+.w8:
+    movu             m0, [resq]
+    vextracti128    xm1, m0, 1
+    packssdw        xm0, xm1
+    movu            xm1, [dstq]
+    paddsw          xm0, xm1
+    CLIPW           xm0, xm2, xm3
+    movu         [dstq], xm0
+    add            resq, 8 * 4
+    add            dstq, strideq
+    dec              hd
+    jg .w8
+    RET
+
+.w16:
+    xor              xq, xq
+.w16_loop:
+    movu             m0, [resq]
+    movu             m1, [dstq + xq * 2]
+    packssdw         m0, [resq + 32]
+    vpermq           m0, m0, q3120
+    paddsw           m0, m1
+    CLIPW            m0, m2, m3
+    movu [dstq + xq * 2], m0
+    add            resq, 16 * 4
+    add              xq, 16
+    cmp              xq, wq
+    jl .w16_loop
+    add            dstq, strideq
+    dec              hd
+    jg .w16
+    RET
+%endmacro
+
+ADD_RESIDUAL_16BPC 10, 1023
+ADD_RESIDUAL_16BPC 12, 4095
+
+%endif ; HAVE_AVX2_EXTERNAL
+%endif ; ARCH_X86_64
@@ -143,6 +143,39 @@ ALF_PROTOTYPES(8,  8,  avx2)
 ALF_PROTOTYPES(16, 10, avx2)
 ALF_PROTOTYPES(16, 12, avx2)
 
+#define SAO_EDGE_FILTER_PROTOTYPE(w, bd, opt)                                                                            \
+void ff_vvc_sao_edge_filter_##w##_##bd##_##opt(uint8_t *dst, const uint8_t *src, ptrdiff_t dst_stride,                   \
+    const int16_t *sao_offset_val, int eo, int width, int height);
+
+#define SAO_BD_PROTOTYPES(bd, opt)                                                                                       \
+    SAO_EDGE_FILTER_PROTOTYPE(8,   bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(16,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(32,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(48,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(64,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(80,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(96,  bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(112, bd, opt)                                                                              \
+    SAO_EDGE_FILTER_PROTOTYPE(128, bd, opt)
+
+SAO_BD_PROTOTYPES(8,  avx2)
+SAO_BD_PROTOTYPES(10, avx2)
+SAO_BD_PROTOTYPES(12, avx2)
+
+#define ITX_PROTOTYPES(bd, opt)                                                                                          \
+void bf(ff_vvc_add_residual, bd, opt)(uint8_t *dst, const int *res, int width, int height, ptrdiff_t stride);
+
+ITX_PROTOTYPES(8,  avx2)
+ITX_PROTOTYPES(10, avx2)
+ITX_PROTOTYPES(12, avx2)
+
+#define LMCS_PROTOTYPES(bd, opt)                                                                                         \
+void bf(ff_vvc_lmcs_filter_luma, bd, opt)(uint8_t *dst, ptrdiff_t dst_stride, int width, int height, const void *lut);
+
+LMCS_PROTOTYPES(8,  avx2)
+LMCS_PROTOTYPES(10, avx2)
+LMCS_PROTOTYPES(12, avx2)
+
 #if ARCH_X86_64
 #if HAVE_SSE4_EXTERNAL
 #define FW_PUT(name, depth, opt) \
@@ -352,6 +385,36 @@ ALF_FUNCS(16, 12, avx2)
     c->alf.classify       = ff_vvc_alf_classify_##bd##_avx2;         \
 } while (0)
 
+#define SAO_INIT(bd) do {                                             \
+    c->sao.band_filter[0] = ff_h2656_sao_band_filter_8_##bd##_avx2;   \
+    c->sao.band_filter[1] = ff_h2656_sao_band_filter_16_##bd##_avx2;  \
+    c->sao.band_filter[2] = ff_h2656_sao_band_filter_32_##bd##_avx2;  \
+    c->sao.band_filter[3] = ff_h2656_sao_band_filter_48_##bd##_avx2;  \
+    c->sao.band_filter[4] = ff_h2656_sao_band_filter_64_##bd##_avx2;  \
+    c->sao.band_filter[5] = ff_h2656_sao_band_filter_80_##bd##_avx2;  \
+    c->sao.band_filter[6] = ff_h2656_sao_band_filter_96_##bd##_avx2;  \
+    c->sao.band_filter[7] = ff_h2656_sao_band_filter_112_##bd##_avx2; \
+    c->sao.band_filter[8] = ff_h2656_sao_band_filter_128_##bd##_avx2; \
+                                                                      \
+    c->sao.edge_filter[0] = ff_vvc_sao_edge_filter_8_##bd##_avx2;     \
+    c->sao.edge_filter[1] = ff_vvc_sao_edge_filter_16_##bd##_avx2;    \
+    c->sao.edge_filter[2] = ff_vvc_sao_edge_filter_32_##bd##_avx2;    \
+    c->sao.edge_filter[3] = ff_vvc_sao_edge_filter_48_##bd##_avx2;    \
+    c->sao.edge_filter[4] = ff_vvc_sao_edge_filter_64_##bd##_avx2;    \
+    c->sao.edge_filter[5] = ff_vvc_sao_edge_filter_80_##bd##_avx2;    \
+    c->sao.edge_filter[6] = ff_vvc_sao_edge_filter_96_##bd##_avx2;    \
+    c->sao.edge_filter[7] = ff_vvc_sao_edge_filter_112_##bd##_avx2;   \
+    c->sao.edge_filter[8] = ff_vvc_sao_edge_filter_128_##bd##_avx2;   \
+} while (0)
+
+#define ITX_INIT(bd) do {                                            \
+    c->itx.add_residual   = ff_vvc_add_residual_##bd##_avx2;         \
+} while (0)
+
+#define LMCS_INIT(bd) do {                                           \
+    c->lmcs.filter        = ff_vvc_lmcs_filter_luma_##bd##_avx2;     \
+} while (0)
+
 int ff_vvc_sad_avx2(const int16_t *src0, const int16_t *src1, int dx, int dy, int block_w, int block_h);
 #define SAD_INIT() c->inter.sad = ff_vvc_sad_avx2
 #endif
@@ -373,6 +436,9 @@ void ff_vvc_dsp_init_x86(VVCDSPContext *const c, const int bd)
             OF_INIT(8);
             DMVR_INIT(8);
             SAD_INIT();
+            SAO_INIT(8);
+            ITX_INIT(8);
+            LMCS_INIT(8);
         }
         break;
     case 10:
@@ -387,6 +453,9 @@ void ff_vvc_dsp_init_x86(VVCDSPContext *const c, const int bd)
             OF_INIT(10);
             DMVR_INIT(10);
             SAD_INIT();
+            SAO_INIT(10);
+            ITX_INIT(10);
+            LMCS_INIT(10);
         }
         break;
     case 12:
@@ -401,6 +470,9 @@ void ff_vvc_dsp_init_x86(VVCDSPContext *const c, const int bd)
             OF_INIT(12);
             DMVR_INIT(12);
             SAD_INIT();
+            SAO_INIT(12);
+            ITX_INIT(12);
+            LMCS_INIT(12);
         }
         break;
     default:
@@ -1887,6 +1887,26 @@ typedef struct AVFormatContext {
      * @see skip_estimate_duration_from_pts
      */
     int64_t duration_probesize;
+
+    /**
+     * Path of a sidecar file used to persist the seek index across opens.
+     * If set, index entries are restored from it after the header has been
+     * read, and written back on avformat_close_input() when new entries
+     * were added. The cache is only used when its recorded input size and
+     * stream layout match the opened input.
+     *
+     * Demuxing only, set by the caller before avformat_open_input().
+     */
+    char *index_cache;
+
+    /**
+     * Number of threads used to decode the probe packets of different
+     * streams concurrently in avformat_find_stream_info(). 1 decodes on the
+     * calling thread, 0 selects a count automatically.
+     *
+     * Demuxing only, set by the caller before avformat_find_stream_info().
+     */
+    int probe_threads;
 } AVFormatContext;
 
 /**
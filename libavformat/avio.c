@@ -61,6 +61,7 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"max_buffer_size", "Maximum size the read buffer may grow to for sequential reads (0 keeps it fixed)", offsetof(URLContext, max_buffer_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64 << 20, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -456,6 +457,9 @@ int ffio_fdopen(AVIOContext **sp, URLContext *h)
     s->seekable = h->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
     s->max_packet_size = max_packet_size;
     s->min_packet_size = h->min_packet_size;
+    if (!(h->flags & AVIO_FLAG_WRITE) && !max_packet_size &&
+        h->max_buffer_size > buffer_size)
+        ffiocontext(s)->max_buffer_size = h->max_buffer_size;
     if(h->prot) {
         s->read_pause = h->prot->url_read_pause;
         s->read_seek  = h->prot->url_read_seek;
@@ -632,8 +636,11 @@ int avio_close(AVIOContext *s)
                "Statistics: %"PRId64" bytes written, %d seeks, %d writeouts\n",
                ctx->bytes_written, ctx->seek_count, ctx->writeout_count);
     else
-        av_log(s, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes read, %d seeks\n",
-               ctx->bytes_read, ctx->seek_count);
+        av_log(s, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes read, %d seeks, "
+               "%d reads (%"PRId64" bytes per read), %d bytes buffer\n",
+               ctx->bytes_read, ctx->seek_count, ctx->read_count,
+               ctx->read_count ? ctx->bytes_read / ctx->read_count : 0,
+               s->buffer_size);
     av_opt_free(s);
 
     error = s->error;
@@ -65,6 +65,23 @@ typedef struct FFIOContext {
      */
     int writeout_count;
 
+    /**
+     * read_packet call statistic
+     */
+    int read_count;
+
+    /**
+     * If non zero, the read buffer is grown up to this size while the
+     * stream is consumed sequentially, and shrunk again on seeks.
+     */
+    int max_buffer_size;
+
+    /**
+     * Number of consecutive buffer refills that were completely filled
+     * and consumed without an intervening seek.
+     */
+    int sequential_refills;
+
     /**
      * Original buffer size
      * used after probing to ensure seekback and to reset the buffer size
@@ -42,6 +42,12 @@
  */
 #define SHORT_SEEK_THRESHOLD 32768
 
+/**
+ * Number of consecutive completely filled and consumed refills after which
+ * an adaptive read buffer is doubled.
+ */
+#define ADAPTIVE_REFILL_COUNT 4
+
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
 /** @warning must be called before any I/O */
@@ -306,6 +312,13 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
             return res;
         ctx->seek_count++;
+        ctx->sequential_refills = 0;
+        /* random access: every refill after a seek reads a whole buffer,
+         * so let an adaptive buffer shrink back towards its default size */
+        if (!s->write_flag && ctx->max_buffer_size && !s->update_checksum &&
+            s->buffer_size > IO_BUFFER_SIZE &&
+            s->buffer_size == ctx->orig_buffer_size)
+            set_buf_size(s, FFMAX(s->buffer_size / 2, IO_BUFFER_SIZE));
         if (!s->write_flag)
             s->buf_end = s->buffer;
         s->buf_ptr = s->buf_ptr_max = s->buffer;
@@ -503,6 +516,7 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
         return AVERROR(EINVAL);
     ret = s->read_packet(s->opaque, buf, size);
     av_assert2(ret || s->max_packet_size);
+    ffiocontext(s)->read_count++;
     return ret;
 }
 
@@ -510,12 +524,13 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 
 static void fill_buffer(AVIOContext *s)
 {
-    FFIOContext *const ctx = (FFIOContext *)s;
-    int max_buffer_size = s->max_packet_size ?
+    FFIOContext *const ctx = ffiocontext(s);
+    int max_read_size   = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
-    uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
+    uint8_t *dst        = s->buf_end - s->buffer + max_read_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    int requested;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -545,6 +560,23 @@ static void fill_buffer(AVIOContext *s)
         len = ctx->orig_buffer_size;
     }
 
+    /* grow the buffer while the input keeps being consumed sequentially,
+     * so that high bitrate streams need fewer read calls */
+    if (ctx->max_buffer_size > s->buffer_size &&
+        ctx->sequential_refills >= ADAPTIVE_REFILL_COUNT &&
+        s->buffer_size == ctx->orig_buffer_size &&
+        dst == s->buffer && s->buf_ptr >= s->buf_end) {
+        int ret = set_buf_size(s, FFMIN(2LL * s->buffer_size, ctx->max_buffer_size));
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Failed to increase buffer size\n");
+            ctx->max_buffer_size = 0;
+        }
+        s->checksum_ptr = dst = s->buffer;
+        len = s->buffer_size;
+        ctx->sequential_refills = 0;
+    }
+
+    requested = len;
     len = read_packet_wrapper(s, dst, len);
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
@@ -559,6 +591,10 @@ static void fill_buffer(AVIOContext *s)
         s->buf_end = dst + len;
         ffiocontext(s)->bytes_read += len;
         s->bytes_read = ffiocontext(s)->bytes_read;
+        if (len == requested)
+            ctx->sequential_refills++;
+        else
+            ctx->sequential_refills = 0;
     }
 }
 
@@ -30,9 +30,11 @@
 #include "avio_internal.h"
 #include "dash.h"
 #include "demux.h"
+#include "httppool.h"
 #include "url.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define HTTP_POOL_SIZE      8
 
 struct fragment {
     int64_t url_offset;
@@ -154,6 +156,8 @@ typedef struct DASHContext {
     AVDictionary *avio_opts;
     int max_url_size;
     char *cenc_decryption_key;
+    int http_persistent;
+    HTTPPool *http_pool;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -446,7 +450,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
-    ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
+    if (c->http_pool)
+        ret = ff_http_pool_open(c->http_pool, pb, url, &tmp);
+    else
+        ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1225,7 +1232,10 @@ static int parse_manifest(AVFormatContext *s, const char *url, AVIOContext *in)
         close_in = 1;
 
         av_dict_copy(&opts, c->avio_opts, 0);
-        ret = avio_open2(&in, url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
+        if (c->http_pool)
+            ret = ff_http_pool_open(c->http_pool, &in, url, &opts);
+        else
+            ret = avio_open2(&in, url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
         av_dict_free(&opts);
         if (ret < 0)
             return ret;
@@ -1368,7 +1378,10 @@ cleanup:
 
     av_bprint_finalize(&buf, NULL);
     if (close_in) {
-        avio_close(in);
+        if (c->http_pool)
+            ff_http_pool_release(c->http_pool, &in);
+        else
+            avio_close(in);
     }
     return ret;
 }
@@ -1713,6 +1726,15 @@ cleanup:
     return ret;
 }
 
+/* Hand a fully read segment connection back for the next request. */
+static void close_input(DASHContext *c, struct representation *pls)
+{
+    if (c->http_pool)
+        ff_http_pool_release(c->http_pool, &pls->input);
+    else
+        ff_format_io_close(pls->parent, &pls->input);
+}
+
 static int update_init_section(struct representation *pls)
 {
     static const int max_init_section_size = 1024 * 1024;
@@ -1748,7 +1770,7 @@ static int update_init_section(struct representation *pls)
 
     ret = read_from_url(pls, pls->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+    close_input(c, pls);
 
     if (ret < 0)
         return ret;
@@ -2023,6 +2045,12 @@ static int dash_read_header(AVFormatContext *s)
 
     c->interrupt_callback = &s->interrupt_callback;
 
+    if (c->http_persistent) {
+        c->http_pool = ff_http_pool_alloc(s, HTTP_POOL_SIZE);
+        if (!c->http_pool)
+            return AVERROR(ENOMEM);
+    }
+
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
@@ -2209,7 +2237,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             cur->is_restart_needed = 0;
-            ff_format_io_close(cur->parent, &cur->input);
+            close_input(c, cur);
             ret = reopen_demux_for_component(s, cur);
         }
     }
@@ -2222,6 +2250,7 @@ static int dash_close(AVFormatContext *s)
     free_audio_list(c);
     free_video_list(c);
     free_subtitle_list(c);
+    ff_http_pool_free(&c->http_pool);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
     return 0;
@@ -2346,6 +2375,8 @@ static const AVOption dash_options[] = {
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
     { "cenc_decryption_key", "Media decryption key (hex)", OFFSET(cenc_decryption_key), AV_OPT_TYPE_STRING, {.str = NULL}, INT_MIN, INT_MAX, .flags = FLAGS },
+    {"http_persistent", "Reuse HTTP connections between requests",
+        OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
     {NULL}
 };
 
@@ -32,6 +32,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 
@@ -338,6 +339,9 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
 
     si->raw_packet_buffer_size = 0;
 
+    if (s->index_cache)
+        ff_index_cache_load(s);
+
     update_stream_avctx(s);
 
     if (options) {
@@ -375,6 +379,13 @@ void avformat_close_input(AVFormatContext **ps)
         (s->flags & AVFMT_FLAG_CUSTOM_IO))
         pb = NULL;
 
+    if (s->iformat && s->index_cache) {
+        int ret = ff_index_cache_save(s);
+        if (ret < 0)
+            av_log(s, AV_LOG_WARNING, "Failed to write index cache '%s': %s\n",
+                   s->index_cache, av_err2str(ret));
+    }
+
     if (s->iformat)
         if (ffifmt(s->iformat)->read_close)
             ffifmt(s->iformat)->read_close(s);
@@ -1620,6 +1631,10 @@ return_packet:
     if ((s->iformat->flags & AVFMT_GENERIC_INDEX) && pkt->flags & AV_PKT_FLAG_KEY) {
         ff_reduce_index(s, st->index);
         av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
+    } else if (si->index_cache_record && pkt->flags & AV_PKT_FLAG_KEY &&
+               pkt->pos >= 0 && pkt->dts != AV_NOPTS_VALUE && !is_relative(pkt->dts)) {
+        ff_reduce_index(s, st->index);
+        av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
     }
 
     if (is_relative(pkt->dts))
@@ -2097,6 +2112,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st,
     int do_skip_frame = 0;
     enum AVDiscard skip_frame;
     int pkt_to_send = pkt->size > 0;
+    int64_t start_time = av_gettime_relative();
 
     if (!frame)
         return AVERROR(ENOMEM);
@@ -2184,9 +2200,74 @@ fail:
     }
 
     av_frame_free(&frame);
+    sti->info->probe_decode_time += av_gettime_relative() - start_time;
     return ret;
 }
 
+#define PROBE_BATCH_SIZE 32
+
+typedef struct ProbePacket {
+    const AVPacket *pkt;
+    AVDictionary  **options;
+    int             nb_frames; ///< codec_info_nb_frames when the packet was read
+} ProbePacket;
+
+/**
+ * State for decoding the probe packets of different streams concurrently.
+ * Packets are queued while reading and decoded in batches, one job per
+ * stream, while the reading thread waits.
+ */
+typedef struct ProbeContext {
+    AVFormatContext *ic;
+    AVSliceThread   *thread;
+    ProbePacket      pkts[PROBE_BATCH_SIZE];
+    int              nb_pkts;
+    int              streams[PROBE_BATCH_SIZE];
+    int              nb_streams;
+} ProbeContext;
+
+static void probe_decode_worker(void *priv, int jobnr, int threadnr,
+                                int nb_jobs, int nb_threads)
+{
+    ProbeContext *const pc = priv;
+    AVStream *const st  = pc->ic->streams[pc->streams[jobnr]];
+    FFStream *const sti = ffstream(st);
+    int nb_frames = sti->codec_info_nb_frames;
+
+    for (int i = 0; i < pc->nb_pkts; i++) {
+        const ProbePacket *const pp = &pc->pkts[i];
+
+        if (pp->pkt->stream_index != st->index)
+            continue;
+        /* try_decode_frame() must see the frame count of the packet it
+         * decodes, as in the sequential case. */
+        sti->codec_info_nb_frames = pp->nb_frames;
+        try_decode_frame(pc->ic, st, pp->pkt, pp->options);
+    }
+    sti->codec_info_nb_frames = nb_frames;
+}
+
+static void probe_decode_flush(ProbeContext *pc)
+{
+    if (!pc->nb_pkts)
+        return;
+
+    pc->nb_streams = 0;
+    for (int i = 0; i < pc->nb_pkts; i++) {
+        int stream_index = pc->pkts[i].pkt->stream_index;
+        int j;
+
+        for (j = 0; j < pc->nb_streams; j++)
+            if (pc->streams[j] == stream_index)
+                break;
+        if (j == pc->nb_streams)
+            pc->streams[pc->nb_streams++] = stream_index;
+    }
+
+    avpriv_slicethread_execute(pc->thread, pc->nb_streams, 0);
+    pc->nb_pkts = 0;
+}
+
 static int chapter_start_cmp(const void *p1, const void *p2)
 {
     const AVChapter *const ch1 = *(AVChapter**)p1;
@@ -2529,6 +2610,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    ProbeContext *pc = NULL;
 
     flush_codecs = probesize > 0;
 
@@ -2608,6 +2690,27 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             av_dict_free(&thread_opt);
     }
 
+    /* Decoding for separate streams is independent, so it can be run in
+     * parallel. Packets must stay valid until their batch is decoded, which
+     * the packet buffer guarantees. */
+    if (ic->probe_threads != 1 && !(ic->flags & AVFMT_FLAG_NOBUFFER)) {
+        pc = av_mallocz(sizeof(*pc));
+        if (!pc) {
+            ret = AVERROR(ENOMEM);
+            goto find_stream_info_err;
+        }
+        pc->ic = ic;
+        ret = avpriv_slicethread_create(&pc->thread, pc, probe_decode_worker,
+                                        NULL, ic->probe_threads);
+        if (ret <= 1) {
+            avpriv_slicethread_free(&pc->thread);
+            av_freep(&pc);
+        } else {
+            av_log(ic, AV_LOG_DEBUG, "Probing streams with %d threads\n", ret);
+        }
+        ret = 0;
+    }
+
     read_size = 0;
     for (;;) {
         const AVPacket *pkt;
@@ -2726,6 +2829,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         sti = ffstream(st);
         if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
             read_size += pkt->size;
+        sti->info->probe_bytes += pkt->size;
 
         avctx = sti->avctx;
         if (!sti->avctx_inited) {
@@ -2837,8 +2941,18 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (pc) {
+            pc->pkts[pc->nb_pkts++] = (ProbePacket) {
+                .pkt       = pkt,
+                .options   = (options && i < orig_nb_streams) ? &options[i] : NULL,
+                .nb_frames = sti->codec_info_nb_frames,
+            };
+            if (pc->nb_pkts == PROBE_BATCH_SIZE)
+                probe_decode_flush(pc);
+        } else {
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
+        }
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt1);
@@ -2847,6 +2961,9 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         count++;
     }
 
+    if (pc)
+        probe_decode_flush(pc);
+
     if (eof_reached) {
         for (unsigned stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
             AVStream *const st = ic->streams[stream_index];
@@ -3098,6 +3215,9 @@ find_stream_info_err:
         int err;
 
         if (sti->info) {
+            av_log(ic, AV_LOG_DEBUG, "Stream #%u: probed %d packets, %"PRId64" bytes, "
+                   "%"PRId64" us decoding\n", i, sti->codec_info_nb_frames,
+                   sti->info->probe_bytes, sti->info->probe_decode_time);
             av_freep(&sti->info->duration_error);
             av_freep(&sti->info);
         }
@@ -3110,6 +3230,10 @@ find_stream_info_err:
 
         av_bsf_free(&sti->extract_extradata.bsf);
     }
+    if (pc) {
+        avpriv_slicethread_free(&pc->thread);
+        av_freep(&pc);
+    }
     if (ic->pb) {
         FFIOContext *const ctx = ffiocontext(ic->pb);
         av_log(ic, AV_LOG_DEBUG, "After avformat_find_stream_info() pos: %"PRId64" bytes read:%"PRId64" seeks:%d frames:%d\n",
@@ -162,6 +162,12 @@ typedef struct FFStreamInfo {
     int     fps_first_dts_idx;
     int64_t fps_last_dts;
     int     fps_last_dts_idx;
+
+    /**
+     * Bytes read and time spent decoding, in microseconds, while probing.
+     */
+    int64_t probe_bytes;
+    int64_t probe_decode_time;
 } FFStreamInfo;
 
 /**
@@ -256,6 +262,18 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
  */
 void ff_reduce_index(AVFormatContext *s, int stream_index);
 
+/**
+ * Restore index entries from AVFormatContext.index_cache.
+ * Called after read_header(); a missing or stale cache is not an error.
+ */
+int ff_index_cache_load(AVFormatContext *s);
+
+/**
+ * Write the index entries to AVFormatContext.index_cache if entries
+ * were added since it was loaded.
+ */
+int ff_index_cache_save(AVFormatContext *s);
+
 /**
  * add frame for rfps calculation.
  *
@@ -27,6 +27,7 @@
  * https://www.rfc-editor.org/rfc/rfc8216.txt
  */
 
+#include "config.h"
 #include "config_components.h"
 
 #include "libavformat/http.h"
@@ -38,9 +39,13 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/executor.h"
+#include "libavutil/fifo.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "demux.h"
+#include "httppool.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
@@ -49,6 +54,8 @@
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define HTTP_POOL_SIZE 8
+#define PREFETCH_CHUNK_SIZE (64 * 1024)
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -86,6 +93,28 @@ struct segment {
     struct segment *init_section;
 };
 
+/*
+ * A segment downloaded ahead of time by a prefetch thread. The data is
+ * appended to the FIFO as it arrives, so the demuxer can start consuming
+ * a segment before it has been fetched completely.
+ */
+struct segment_prefetch {
+    AVTask task;
+    struct segment_prefetch *next;
+    int64_t seq_no;
+    unsigned order;
+    char *url;
+    int64_t size;
+    AVDictionary *opts;
+
+    /* protected by HLSContext.prefetch_lock */
+    AVFifo *fifo;
+    int active;
+    int abort;
+    int done;
+    int ret;
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -107,6 +136,11 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    /* queued prefetches, oldest first, and the one being read */
+    struct segment_prefetch *prefetch_head, *prefetch_tail;
+    struct segment_prefetch *prefetch_cur;
+    int n_prefetch;
+    AVExecutor *prefetch_executor;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -220,6 +254,8 @@ typedef struct HLSContext {
     int64_t first_timestamp;
     int64_t cur_timestamp;
     AVIOInterruptCB *interrupt_callback;
+    /* interrupt callback of the requests made from prefetch threads */
+    AVIOInterruptCB prefetch_int_cb;
     AVDictionary *avio_opts;
     AVDictionary *seg_format_opts;
     char *allowed_extensions;
@@ -229,9 +265,163 @@ typedef struct HLSContext {
     int http_seekable;
     int seg_max_retry;
     AVIOContext *playlist_pb;
+    HTTPPool *http_pool;
+    int prefetch_segments;
+    int64_t prefetch_max_bytes;
+    AVMutex prefetch_lock;
+    AVCond prefetch_cond;
+    int64_t prefetch_bytes;
+    unsigned prefetch_order;
     HLSCryptoContext  crypto_ctx;
 } HLSContext;
 
+static int prefetch_priority_higher(const AVTask *a, const AVTask *b)
+{
+    return ((const struct segment_prefetch *)a)->order <
+           ((const struct segment_prefetch *)b)->order;
+}
+
+static int prefetch_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+#if HAVE_THREAD_LOCAL
+/* the prefetch run by the calling thread, NULL outside of prefetch_run() */
+static _Thread_local struct segment_prefetch *prefetch_self;
+#endif
+
+/*
+ * Interrupt callback of all connections opened while prefetching. Besides
+ * the caller's callback, it checks whether the prefetch using the connection
+ * was cancelled, so that cancelling does not wait for a stalled request.
+ * Pooled connections keep this callback when they move between threads,
+ * hence the lookup through the calling thread.
+ */
+static int prefetch_interrupt(void *opaque)
+{
+    HLSContext *c = opaque;
+    int abort = 0;
+
+#if HAVE_THREAD_LOCAL
+    if (prefetch_self) {
+        ff_mutex_lock(&c->prefetch_lock);
+        abort = prefetch_self->abort;
+        ff_mutex_unlock(&c->prefetch_lock);
+    }
+#endif
+    return abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+static int prefetch_run(AVTask *t, void *local_context, void *user_data)
+{
+    HLSContext *c = user_data;
+    struct segment_prefetch *p = (struct segment_prefetch *)t;
+    uint8_t *buf = local_context;
+    int64_t remaining = p->size >= 0 ? p->size : INT64_MAX;
+    AVIOContext *in = NULL;
+    int ret;
+
+    ff_mutex_lock(&c->prefetch_lock);
+    ret = p->abort ? AVERROR_EXIT : 0;
+    ff_mutex_unlock(&c->prefetch_lock);
+
+#if HAVE_THREAD_LOCAL
+    prefetch_self = p;
+#endif
+    if (!ret) {
+        if (c->http_pool)
+            ret = ff_http_pool_open(c->http_pool, &in, p->url, &p->opts);
+        else
+            ret = ffio_open_whitelist(&in, p->url, AVIO_FLAG_READ, &c->prefetch_int_cb,
+                                      &p->opts, c->ctx->protocol_whitelist,
+                                      c->ctx->protocol_blacklist);
+    }
+
+    while (ret >= 0 && remaining > 0) {
+        int len = avio_read(in, buf, FFMIN(remaining, PREFETCH_CHUNK_SIZE));
+        if (len <= 0) {
+            ret = len == AVERROR_EOF ? 0 : len;
+            break;
+        }
+        remaining -= len;
+
+        /* The segment being read is exempt from the byte budget, so that
+         * the demuxer always makes progress. */
+        ff_mutex_lock(&c->prefetch_lock);
+        while (!p->abort && !p->active && c->prefetch_bytes >= c->prefetch_max_bytes)
+            ff_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+        if (p->abort) {
+            ret = AVERROR_EXIT;
+        } else if ((ret = av_fifo_write(p->fifo, buf, len)) >= 0) {
+            c->prefetch_bytes += len;
+            ff_cond_broadcast(&c->prefetch_cond);
+        }
+        ff_mutex_unlock(&c->prefetch_lock);
+    }
+
+    if (c->http_pool)
+        ff_http_pool_release(c->http_pool, &in);
+    else
+        ff_format_io_close(c->ctx, &in);
+#if HAVE_THREAD_LOCAL
+    prefetch_self = NULL;
+#endif
+
+    ff_mutex_lock(&c->prefetch_lock);
+    p->ret  = ret;
+    p->done = 1;
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_lock);
+    return 0;
+}
+
+static void prefetch_free(HLSContext *c, struct segment_prefetch **pp)
+{
+    struct segment_prefetch *p = *pp;
+
+    if (!p)
+        return;
+
+    ff_mutex_lock(&c->prefetch_lock);
+    p->abort = 1;
+    ff_cond_broadcast(&c->prefetch_cond);
+    while (!p->done)
+        ff_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    if (p->fifo)
+        c->prefetch_bytes -= av_fifo_can_read(p->fifo);
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_lock);
+
+    av_fifo_freep2(&p->fifo);
+    av_dict_free(&p->opts);
+    av_free(p->url);
+    av_freep(pp);
+}
+
+/* Cancel all prefetches of a playlist, e.g. when it is seeked. */
+static void prefetch_flush(HLSContext *c, struct playlist *pls)
+{
+    struct segment_prefetch *p;
+
+    if (!pls->prefetch_cur && !pls->prefetch_head)
+        return;
+
+    ff_mutex_lock(&c->prefetch_lock);
+    for (p = pls->prefetch_head; p; p = p->next)
+        p->abort = 1;
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_lock);
+
+    prefetch_free(c, &pls->prefetch_cur);
+    while ((p = pls->prefetch_head)) {
+        pls->prefetch_head = p->next;
+        prefetch_free(c, &p);
+    }
+    pls->prefetch_tail = NULL;
+    pls->n_prefetch    = 0;
+}
+
 static void free_segment_dynarray(struct segment **segments, int n_segments)
 {
     int i;
@@ -276,6 +466,8 @@ static void free_playlist_list(HLSContext *c)
         av_freep(&pls->init_sec_buf);
         av_packet_free(&pls->pkt);
         av_freep(&pls->pb.pub.buffer);
+        prefetch_flush(c, pls);
+        av_executor_free(&pls->prefetch_executor);
         ff_format_io_close(c->ctx, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
@@ -707,8 +899,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     url, av_err2str(ret));
             av_dict_copy(&tmp, *opts, 0);
             av_dict_copy(&tmp, opts2, 0);
-            ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+            ret = ff_http_pool_open(c->http_pool, pb, url, &tmp);
         }
+    } else if (is_http && c->http_pool) {
+        ret = ff_http_pool_open(c->http_pool, pb, url, &tmp);
     } else {
         ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
     }
@@ -1063,11 +1257,39 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static int prefetch_read(HLSContext *c, struct playlist *pls,
+                         uint8_t *buf, int buf_size)
+{
+    struct segment_prefetch *p = pls->prefetch_cur;
+    int ret;
+
+    ff_mutex_lock(&c->prefetch_lock);
+    while (!p->done && !av_fifo_can_read(p->fifo))
+        ff_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    ret = FFMIN(av_fifo_can_read(p->fifo), buf_size);
+    if (ret > 0) {
+        av_fifo_read(p->fifo, buf, ret);
+        c->prefetch_bytes -= ret;
+        ff_cond_broadcast(&c->prefetch_cond);
+    } else {
+        ret = p->ret;
+    }
+    ff_mutex_unlock(&c->prefetch_lock);
+
+    if (ret > 0)
+        pls->cur_seg_offset += ret;
+    return ret;
+}
+
+/* Read from the current segment, through its prefetch buffer if it has one. */
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
     int ret;
 
+    if (pls->prefetch_cur)
+        return prefetch_read(pls->parent->priv_data, pls, buf, buf_size);
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -1280,6 +1502,135 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
+/* Keep completely read HTTP connections around for later requests. */
+static void close_url(HLSContext *c, AVIOContext **pb)
+{
+    if (c->http_pool)
+        ff_http_pool_release(c->http_pool, pb);
+    else
+        ff_format_io_close(c->ctx, pb);
+}
+
+static int can_prefetch(const struct segment *seg)
+{
+    return seg->key_type == KEY_NONE &&
+           (av_strstart(seg->url, "http://", NULL) ||
+            av_strstart(seg->url, "https://", NULL));
+}
+
+/* Queue the segments following the last queued one, up to the window. */
+static int prefetch_fill(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no = pls->prefetch_tail ? pls->prefetch_tail->seq_no + 1
+                                        : pls->cur_seq_no;
+
+    while (pls->n_prefetch + !!pls->prefetch_cur < c->prefetch_segments &&
+           seq_no >= pls->start_seq_no &&
+           seq_no <  pls->start_seq_no + pls->n_segments) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct segment_prefetch *p;
+
+        if (!can_prefetch(seg))
+            break;
+
+        p = av_mallocz(sizeof(*p));
+        if (!p)
+            return AVERROR(ENOMEM);
+        p->seq_no = seq_no;
+        p->order  = c->prefetch_order++;
+        p->size   = seg->size;
+        p->url    = av_strdup(seg->url);
+        p->fifo   = av_fifo_alloc2(PREFETCH_CHUNK_SIZE, 1, AV_FIFO_FLAG_AUTO_GROW);
+        if (!p->url || !p->fifo ||
+            av_dict_copy(&p->opts, c->avio_opts, 0) < 0) {
+            p->done = 1;
+            prefetch_free(c, &p);
+            return AVERROR(ENOMEM);
+        }
+        if (c->http_persistent)
+            av_dict_set(&p->opts, "multiple_requests", "1", 0);
+        if (seg->size >= 0) {
+            av_dict_set_int(&p->opts, "offset", seg->url_offset, 0);
+            av_dict_set_int(&p->opts, "end_offset", seg->url_offset + seg->size, 0);
+        }
+
+        if (pls->prefetch_tail)
+            pls->prefetch_tail->next = p;
+        else
+            pls->prefetch_head = p;
+        pls->prefetch_tail = p;
+        pls->n_prefetch++;
+
+        av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', playlist %d\n",
+               seg->url, pls->index);
+        av_executor_execute(pls->prefetch_executor, &p->task);
+        seq_no++;
+    }
+    return 0;
+}
+
+/*
+ * Make the prefetch of the current segment the active input. Returns 1 if
+ * the segment is read from the prefetch, 0 if it has to be opened directly.
+ */
+static int prefetch_open(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+    struct segment_prefetch *p;
+    int failed, ret;
+
+    if (!can_prefetch(seg)) {
+        prefetch_flush(c, pls);
+        return 0;
+    }
+
+    if (!pls->prefetch_executor) {
+        const AVTaskCallbacks callbacks = {
+            .user_data          = c,
+            .local_context_size = PREFETCH_CHUNK_SIZE,
+            .priority_higher    = prefetch_priority_higher,
+            .ready              = prefetch_ready,
+            .run                = prefetch_run,
+        };
+        /* One thread per window slot, so that no queued segment ever waits
+         * for a thread held by a segment blocked on the byte budget. */
+        pls->prefetch_executor = av_executor_alloc(&callbacks, c->prefetch_segments);
+        if (!pls->prefetch_executor)
+            return AVERROR(ENOMEM);
+    }
+
+    if (pls->prefetch_head && pls->prefetch_head->seq_no != pls->cur_seq_no)
+        prefetch_flush(c, pls);
+    if (!pls->prefetch_head && (ret = prefetch_fill(c, pls)) < 0)
+        return ret;
+    if (!(p = pls->prefetch_head))
+        return 0;
+
+    pls->prefetch_head = p->next;
+    if (!pls->prefetch_head)
+        pls->prefetch_tail = NULL;
+    pls->n_prefetch--;
+    pls->prefetch_cur = p;
+
+    if ((ret = prefetch_fill(c, pls)) < 0)
+        return ret;
+
+    ff_mutex_lock(&c->prefetch_lock);
+    p->active = 1;
+    ff_cond_broadcast(&c->prefetch_cond);
+    while (!p->done && !av_fifo_can_read(p->fifo))
+        ff_cond_wait(&c->prefetch_cond, &c->prefetch_lock);
+    failed = p->ret < 0 && !av_fifo_can_read(p->fifo);
+    ff_mutex_unlock(&c->prefetch_lock);
+
+    /* Let the regular open path with its retry logic handle failures. */
+    if (failed) {
+        prefetch_free(c, &pls->prefetch_cur);
+        return 0;
+    }
+    pls->cur_seg_offset = 0;
+    return 1;
+}
+
 static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
 {
     AVDictionary *opts = NULL;
@@ -1308,7 +1659,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
                 }
-                ff_format_io_close(pls->parent, &pb);
+                close_url(c, &pb);
             } else {
                 av_log(pls->parent, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
@@ -1404,7 +1755,7 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
 
     ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+    close_url(c, &pls->input);
 
     if (ret < 0)
         return ret;
@@ -1487,7 +1838,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch_cur) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1558,7 +1910,11 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments &&
+            (ret = prefetch_open(c, v, seg)) != 0) {
+            if (ret > 0)
+                close_url(c, &v->input);
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1630,11 +1986,13 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch_cur) {
+        prefetch_free(c, &v->prefetch_cur);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
-        ff_format_io_close(v->parent, &v->input);
+        close_url(c, &v->input);
     }
     v->cur_seq_no++;
 
@@ -1923,6 +2281,12 @@ static int hls_close(AVFormatContext *s)
 
     av_dict_free(&c->avio_opts);
     ff_format_io_close(c->ctx, &c->playlist_pb);
+    ff_http_pool_free(&c->http_pool);
+
+    if (c->prefetch_segments) {
+        ff_cond_destroy(&c->prefetch_cond);
+        ff_mutex_destroy(&c->prefetch_lock);
+    }
 
     return 0;
 }
@@ -1940,6 +2304,42 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+    if (c->http_persistent) {
+        c->http_pool = ff_http_pool_alloc(s, HTTP_POOL_SIZE);
+        if (!c->http_pool)
+            return AVERROR(ENOMEM);
+    }
+
+    if (c->prefetch_segments && !HAVE_THREADS) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetch requires threads, disabling it\n");
+        c->prefetch_segments = 0;
+    }
+    /* Prefetch threads open and close URLs concurrently with the caller's
+     * thread, which custom I/O callbacks are not expected to support. */
+    if (c->prefetch_segments && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetch is not supported with custom "
+               "I/O callbacks, disabling it\n");
+        c->prefetch_segments = 0;
+    }
+    if (c->prefetch_segments) {
+        if ((ret = ff_mutex_init(&c->prefetch_lock, NULL))) {
+            c->prefetch_segments = 0;
+            return AVERROR(ret);
+        }
+        if ((ret = ff_cond_init(&c->prefetch_cond, NULL))) {
+            ff_mutex_destroy(&c->prefetch_lock);
+            c->prefetch_segments = 0;
+            return AVERROR(ret);
+        }
+        /* prefetching already keeps several requests in flight */
+        c->http_multiple = 0;
+
+        c->prefetch_int_cb.callback = prefetch_interrupt;
+        c->prefetch_int_cb.opaque   = c;
+        if (c->http_pool)
+            ff_http_pool_set_interrupt_callback(c->http_pool, &c->prefetch_int_cb);
+    }
+
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
@@ -2238,6 +2638,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            prefetch_flush(c, pls);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2494,6 +2895,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
+        prefetch_flush(c, pls);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2590,6 +2992,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments per playlist to download concurrently ahead of the demuxer (0 = disabled)",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_bytes", "Maximum amount of prefetched data held in memory",
+        OFFSET(prefetch_max_bytes), AV_OPT_TYPE_INT64, {.i64 = 32 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
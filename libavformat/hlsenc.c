@@ -22,6 +22,7 @@
 
 #include "config.h"
 #include "config_components.h"
+#include <stdatomic.h>
 #include <stdint.h>
 #include <time.h>
 #if HAVE_UNISTD_H
@@ -37,6 +38,8 @@
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
 #include "libavutil/random_seed.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
@@ -191,6 +194,25 @@ typedef struct VariantStream {
     const char *varname;  /* variant name */
 } VariantStream;
 
+typedef enum HLSIOJobType {
+    HLS_IO_WRITE,
+    HLS_IO_DELETE,
+} HLSIOJobType;
+
+/**
+ * File operation executed by the background I/O thread, see hls_async_io.
+ * Jobs own all their data and never point into the HLSContext, which the
+ * muxing thread keeps using meanwhile.
+ */
+typedef struct HLSIOJob {
+    HLSIOJobType type;
+    char *filename;     ///< file to write or delete
+    char *final_name;   ///< if set, filename is renamed to this after writing
+    const char *proto;  ///< protocol of the output, for deletion
+    uint8_t *data;
+    int size;
+} HLSIOJob;
+
 typedef struct ClosedCaptionsStream {
     const char *ccgroup;    /* closed caption group name */
     const char *instreamid; /* closed captions INSTREAM-ID */
@@ -262,6 +284,14 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+
+    int async_io;
+    AVThreadMessageQueue *io_queue;
+#if HAVE_THREADS
+    pthread_t io_thread;
+#endif
+    int io_thread_started;
+    atomic_int io_error;
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -576,8 +606,55 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
-static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
-                           char *path, const char *proto)
+static void free_io_job(void *msg)
+{
+    HLSIOJob *job = msg;
+    av_freep(&job->filename);
+    av_freep(&job->final_name);
+    av_freep(&job->data);
+}
+
+static int hls_queue_io_job(AVFormatContext *s, HLSIOJob *job)
+{
+    HLSContext *hls = s->priv_data;
+    int ret = av_thread_message_queue_send(hls->io_queue, job, 0);
+
+    if (ret < 0)
+        free_io_job(job);
+    return ret;
+}
+
+/**
+ * Hand a playlist built in a dynamic buffer over to the I/O thread.
+ */
+static int queue_playlist(AVFormatContext *s, AVIOContext **dyn_buf,
+                          const char *filename, const char *final_name)
+{
+    HLSIOJob job = { .type = HLS_IO_WRITE };
+    int size;
+
+    if (!*dyn_buf)
+        return 0;
+
+    size = avio_close_dyn_buf(*dyn_buf, &job.data);
+    *dyn_buf = NULL;
+    if (size < 0) {
+        av_free(job.data);
+        return size;
+    }
+    job.size     = size;
+    job.filename = av_strdup(filename);
+    if (strcmp(filename, final_name))
+        job.final_name = av_strdup(final_name);
+    if (!job.filename || (strcmp(filename, final_name) && !job.final_name)) {
+        free_io_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return hls_queue_io_job(s, &job);
+}
+
+static int do_delete_file(HLSContext *hls, AVFormatContext *avf, AVIOContext **pb,
+                          char *path, const char *proto)
 {
     if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
         AVDictionary *opt = NULL;
@@ -586,13 +663,13 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
         set_http_options(avf, &opt, hls);
         av_dict_set(&opt, "method", "DELETE", 0);
 
-        ret = hlsenc_io_open(avf, &hls->http_delete, path, &opt);
+        ret = hlsenc_io_open(avf, pb, path, &opt);
         av_dict_free(&opt);
         if (ret < 0)
             return hls->ignore_io_errors ? 1 : ret;
 
         //Nothing to write
-        hlsenc_io_close(avf, &hls->http_delete, path);
+        hlsenc_io_close(avf, pb, path);
     } else if (unlink(path) < 0) {
         av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                path, strerror(errno));
@@ -600,6 +677,20 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
     return 0;
 }
 
+static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
+                           char *path, const char *proto)
+{
+    if (hls->io_queue) {
+        HLSIOJob job = { .type = HLS_IO_DELETE, .proto = proto };
+
+        job.filename = av_strdup(path);
+        if (!job.filename)
+            return AVERROR(ENOMEM);
+        return hls_queue_io_job(avf, &job);
+    }
+    return do_delete_file(hls, avf, &hls->http_delete, path, proto);
+}
+
 static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
                                    VariantStream *vs)
 {
@@ -1397,6 +1488,8 @@ static int create_master_playlist(AVFormatContext *s,
     int is_file_proto = proto && !strcmp(proto, "file");
     int use_temp_file = is_file_proto && ((hls->flags & HLS_TEMP_FILE) || hls->master_publish_rate);
     char temp_filename[MAX_URL_SIZE];
+    AVIOContext *master_buf = NULL;
+    AVIOContext **pb = hls->io_queue ? &master_buf : &hls->m3u8_out;
     int nb_channels;
 
     input_vs->m3u8_created = 1;
@@ -1414,7 +1507,10 @@ static int create_master_playlist(AVFormatContext *s,
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", hls->master_m3u8_url);
-    ret = hlsenc_io_open(s, &hls->m3u8_out, temp_filename, &options);
+    if (hls->io_queue)
+        ret = avio_open_dyn_buf(pb);
+    else
+        ret = hlsenc_io_open(s, pb, temp_filename, &options);
     av_dict_free(&options);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open master play list file '%s'\n",
@@ -1422,16 +1518,16 @@ static int create_master_playlist(AVFormatContext *s,
         goto fail;
     }
 
-    ff_hls_write_playlist_version(hls->m3u8_out, hls->version);
+    ff_hls_write_playlist_version(*pb, hls->version);
 
     for (i = 0; i < hls->nb_ccstreams; i++) {
         ccs = &(hls->cc_streams[i]);
-        avio_printf(hls->m3u8_out, "#EXT-X-MEDIA:TYPE=CLOSED-CAPTIONS");
-        avio_printf(hls->m3u8_out, ",GROUP-ID=\"%s\"", ccs->ccgroup);
-        avio_printf(hls->m3u8_out, ",NAME=\"%s\"", ccs->instreamid);
+        avio_printf(*pb, "#EXT-X-MEDIA:TYPE=CLOSED-CAPTIONS");
+        avio_printf(*pb, ",GROUP-ID=\"%s\"", ccs->ccgroup);
+        avio_printf(*pb, ",NAME=\"%s\"", ccs->instreamid);
         if (ccs->language)
-            avio_printf(hls->m3u8_out, ",LANGUAGE=\"%s\"", ccs->language);
-        avio_printf(hls->m3u8_out, ",INSTREAM-ID=\"%s\"\n", ccs->instreamid);
+            avio_printf(*pb, ",LANGUAGE=\"%s\"", ccs->language);
+        avio_printf(*pb, ",INSTREAM-ID=\"%s\"\n", ccs->instreamid);
     }
 
     /* For audio only variant streams add #EXT-X-MEDIA tag with attributes*/
@@ -1452,7 +1548,7 @@ static int create_master_playlist(AVFormatContext *s,
                 if (vs->streams[j]->codecpar->ch_layout.nb_channels > nb_channels)
                     nb_channels = vs->streams[j]->codecpar->ch_layout.nb_channels;
 
-        ff_hls_write_audio_rendition(hls->m3u8_out, vs->agroup, m3u8_rel_name, vs->language, i, hls->has_default_key ? vs->is_default : 1, nb_channels);
+        ff_hls_write_audio_rendition(*pb, vs->agroup, m3u8_rel_name, vs->language, i, hls->has_default_key ? vs->is_default : 1, nb_channels);
     }
 
     /* For variant streams with video add #EXT-X-STREAM-INF tag with attributes*/
@@ -1533,29 +1629,146 @@ static int create_master_playlist(AVFormatContext *s,
                 break;
             }
 
-            ff_hls_write_subtitle_rendition(hls->m3u8_out, sgroup, vtt_m3u8_rel_name, vs->language, i, hls->has_default_key ? vs->is_default : 1);
+            ff_hls_write_subtitle_rendition(*pb, sgroup, vtt_m3u8_rel_name, vs->language, i, hls->has_default_key ? vs->is_default : 1);
         }
 
         if (!hls->has_default_key || !hls->has_video_m3u8) {
-            ff_hls_write_stream_info(vid_st, hls->m3u8_out, bandwidth, avg_bandwidth, m3u8_rel_name,
+            ff_hls_write_stream_info(vid_st, *pb, bandwidth, avg_bandwidth, m3u8_rel_name,
                     aud_st ? vs->agroup : NULL, vs->codec_attr, ccgroup, sgroup);
         } else {
             if (vid_st) {
-                ff_hls_write_stream_info(vid_st, hls->m3u8_out, bandwidth, avg_bandwidth, m3u8_rel_name,
+                ff_hls_write_stream_info(vid_st, *pb, bandwidth, avg_bandwidth, m3u8_rel_name,
                                          aud_st ? vs->agroup : NULL, vs->codec_attr, ccgroup, sgroup);
             }
         }
     }
 fail:
+    if (hls->io_queue) {
+        int ret2 = queue_playlist(s, pb, temp_filename, hls->master_m3u8_url);
+        ffio_free_dyn_buf(pb);
+        if (ret >= 0)
+            ret = ret2;
+        if (ret >= 0)
+            hls->master_m3u8_created = 1;
+        return ret;
+    }
     if (ret >=0)
         hls->master_m3u8_created = 1;
-    hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
+    hlsenc_io_close(s, pb, temp_filename);
     if (use_temp_file)
         ff_rename(temp_filename, hls->master_m3u8_url, s);
 
     return ret;
 }
 
+static int write_file(AVFormatContext *s, AVIOContext **pb, HLSIOJob *job)
+{
+    HLSContext *hls = s->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, pb, job->filename, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+    avio_write(*pb, job->data, job->size);
+    ret = hlsenc_io_close(s, pb, job->filename);
+    if (ret < 0)
+        return ret;
+    if (job->final_name)
+        ff_rename(job->filename, job->final_name, s);
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *io_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    HLSContext *hls = s->priv_data;
+    /* the contexts of the I/O thread, persistent HTTP sessions are kept in them */
+    AVIOContext *out = NULL, *http_delete = NULL;
+    HLSIOJob job;
+
+    while (av_thread_message_queue_recv(hls->io_queue, &job, 0) >= 0) {
+        int ret;
+
+        if (job.type == HLS_IO_WRITE) {
+            ret = write_file(s, &out, &job);
+            if (ret < 0) {
+                av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
+                ff_format_io_close(s, &out);
+                ret = write_file(s, &out, &job);
+            }
+        } else {
+            ret = do_delete_file(hls, s, &http_delete, job.filename, job.proto);
+        }
+        free_io_job(&job);
+
+        if (ret < 0 && !hls->ignore_io_errors) {
+            int expected = 0;
+            av_log(s, AV_LOG_ERROR, "Background I/O failed: %s\n", av_err2str(ret));
+            atomic_compare_exchange_strong(&hls->io_error, &expected, ret);
+        }
+    }
+    ff_format_io_close(s, &out);
+    ff_format_io_close(s, &http_delete);
+    return NULL;
+}
+#endif
+
+/**
+ * Start the thread that writes playlists and deletes old segments, so that
+ * slow storage or HTTP uploads do not stall muxing. Jobs are executed in
+ * order, which keeps playlist updates, renames and deletions in the same
+ * sequence as in synchronous mode.
+ */
+static int start_io_thread(AVFormatContext *s)
+{
+#if HAVE_THREADS
+    HLSContext *hls = s->priv_data;
+    int ret;
+
+    atomic_init(&hls->io_error, 0);
+    ret = av_thread_message_queue_alloc(&hls->io_queue, 32, sizeof(HLSIOJob));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(hls->io_queue, free_io_job);
+
+    ret = pthread_create(&hls->io_thread, NULL, io_thread, s);
+    if (ret) {
+        av_log(s, AV_LOG_ERROR, "Failed to start I/O thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    hls->io_thread_started = 1;
+    return 0;
+#else
+    av_log(s, AV_LOG_ERROR, "hls_async_io requires threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
+/**
+ * Wait until all queued jobs are done and stop the I/O thread.
+ */
+static int stop_io_thread(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (!hls->io_queue)
+        return 0;
+
+    av_thread_message_queue_set_err_recv(hls->io_queue, AVERROR_EOF);
+#if HAVE_THREADS
+    if (hls->io_thread_started)
+        pthread_join(hls->io_thread, NULL);
+#endif
+    hls->io_thread_started = 0;
+    av_thread_message_queue_free(&hls->io_queue);
+    return atomic_load(&hls->io_error);
+}
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1575,6 +1788,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    AVIOContext *pl_buf = NULL, *sub_pl_buf = NULL;
+    AVIOContext **pb = byterange_mode ? &hls->m3u8_out : &vs->out;
+    AVIOContext **sub_pb = &hls->sub_m3u8_out;
+
+    if (hls->io_queue) {
+        /* report failures of earlier background writes */
+        if ((ret = atomic_load(&hls->io_error)) < 0)
+            return ret;
+        pb     = &pl_buf;
+        sub_pb = &sub_pl_buf;
+    }
 
     hls->version = 2;
     if (!(hls->flags & HLS_ROUND_DURATIONS)) {
@@ -1603,7 +1827,10 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options);
+    if (hls->io_queue)
+        ret = avio_open_dyn_buf(pb);
+    else
+        ret = hlsenc_io_open(s, pb, temp_filename, &options);
     av_dict_free(&options);
     if (ret < 0) {
         goto fail;
@@ -1615,33 +1842,33 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     }
 
     vs->discontinuity_set = 0;
-    ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
+    ff_hls_write_playlist_header(*pb, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
+        avio_printf(*pb, "#EXT-X-DISCONTINUITY\n");
         vs->discontinuity_set = 1;
     }
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+        avio_printf(*pb, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
     for (en = vs->segments; en; en = en->next) {
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
+            avio_printf(*pb, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
             if (*en->iv_string)
-                avio_printf(byterange_mode ? hls->m3u8_out : vs->out, ",IV=0x%s", en->iv_string);
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "\n");
+                avio_printf(*pb, ",IV=0x%s", en->iv_string);
+            avio_printf(*pb, "\n");
             key_uri = en->key_uri;
             iv_string = en->iv_string;
         }
 
         if ((hls->segment_type == SEGMENT_TYPE_FMP4) && (en == vs->segments)) {
-            ff_hls_write_init_file(byterange_mode ? hls->m3u8_out : vs->out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
+            ff_hls_write_init_file(*pb, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
-        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
+        ret = ff_hls_write_file_entry(*pb, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
                                       en->filename,
@@ -1655,20 +1882,23 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     }
 
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
-        ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
+        ff_hls_write_end_list(*pb);
 
     if (vs->vtt_m3u8_name) {
         set_http_options(vs->vtt_avf, &options, hls);
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
-        ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options);
+        if (hls->io_queue)
+            ret = avio_open_dyn_buf(sub_pb);
+        else
+            ret = hlsenc_io_open(s, sub_pb, temp_vtt_filename, &options);
         av_dict_free(&options);
         if (ret < 0) {
             goto fail;
         }
-        ff_hls_write_playlist_header(hls->sub_m3u8_out, hls->version, hls->allowcache,
+        ff_hls_write_playlist_header(*sub_pb, hls->version, hls->allowcache,
                                      target_duration, sequence, PLAYLIST_TYPE_NONE, 0);
         for (en = vs->segments; en; en = en->next) {
-            ret = ff_hls_write_file_entry(hls->sub_m3u8_out, 0, byterange_mode,
+            ret = ff_hls_write_file_entry(*sub_pb, 0, byterange_mode,
                                           en->duration, 0, en->size, en->pos,
                                           hls->baseurl, en->sub_filename, NULL, 0, 0, 0);
             if (ret < 0) {
@@ -1677,22 +1907,35 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
 
         if (last)
-            ff_hls_write_end_list(hls->sub_m3u8_out);
+            ff_hls_write_end_list(*sub_pb);
 
     }
 
 fail:
     av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    if (hls->io_queue) {
+        int ret2;
+        /* the I/O thread writes playlists through its own context */
+        ret2 = queue_playlist(s, pb, temp_filename, vs->m3u8_name);
+        if (ret2 >= 0 && vs->vtt_m3u8_name)
+            ret2 = queue_playlist(s, sub_pb, temp_vtt_filename, vs->vtt_m3u8_name);
+        ffio_free_dyn_buf(pb);
+        ffio_free_dyn_buf(sub_pb);
+        if (ret >= 0)
+            ret = ret2;
+        goto master;
+    }
+    ret = hlsenc_io_close(s, pb, temp_filename);
     if (ret < 0) {
         return ret;
     }
-    hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    hlsenc_io_close(s, sub_pb, vs->vtt_m3u8_name);
     if (use_temp_file) {
         ff_rename(temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
             ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
+master:
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs, last) < 0)
             av_log(s, AV_LOG_WARNING, "Master playlist creation failed\n");
@@ -2721,6 +2964,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    stop_io_thread(s);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2885,7 +3130,7 @@ failed:
         av_free(old_filename);
     }
 
-    return 0;
+    return stop_io_thread(s);
 }
 
 
@@ -3137,6 +3382,9 @@ static int hls_init(AVFormatContext *s)
         vs->number++;
     }
 
+    if (hls->async_io && (ret = start_io_thread(s)) < 0)
+        return ret;
+
     return ret;
 }
 
@@ -3201,6 +3449,7 @@ static const AVOption options[] = {
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    {"hls_async_io", "write playlists and delete old segments in a background thread", OFFSET(async_io), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { NULL },
 };
 
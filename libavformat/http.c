@@ -537,6 +537,26 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
     return ret;
 }
 
+int ff_http_connection_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end;
+
+    if (!h->prot ||
+        !(!strcmp(h->prot->name, "http") ||
+          !strcmp(h->prot->name, "https")))
+        return 0;
+    if (!s->hd || s->willclose || !s->multiple_requests ||
+        h->flags & AVIO_FLAG_WRITE)
+        return 0;
+
+    /* Only responses with a known length are tracked precisely enough to
+     * tell that nothing of them is left on the wire. */
+    target_end = s->end_off ? s->end_off : s->filesize;
+    return s->chunksize == UINT64_MAX && target_end != UINT64_MAX &&
+           s->off >= target_end && s->buf_ptr == s->buf_end;
+}
+
 int ff_http_averror(int status_code, int default_averror)
 {
     switch (status_code) {
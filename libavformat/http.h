@@ -60,6 +60,16 @@ int ff_http_do_new_request(URLContext *h, const char *uri);
  */
 int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **options);
 
+/**
+ * Check whether the response on a connection has been read completely, so
+ * that the connection can carry another request with
+ * ff_http_do_new_request2().
+ *
+ * @param h pointer to the resource
+ * @return 1 if the connection can be reused, 0 otherwise
+ */
+int ff_http_connection_reusable(URLContext *h);
+
 int ff_http_averror(int status_code, int default_averror);
 
 #endif /* AVFORMAT_HTTP_H */
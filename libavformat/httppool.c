@@ -0,0 +1,214 @@
+/*
+ * Shared pool of persistent HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config_components.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "http.h"
+#include "httppool.h"
+#include "internal.h"
+#include "url.h"
+
+#define POOL_PROTO_SIZE 10
+#define POOL_HOST_SIZE  1024
+/* "<proto>://<host>:<port>" */
+#define POOL_KEY_SIZE   (POOL_PROTO_SIZE + 3 + POOL_HOST_SIZE + 1 + 11 + 1)
+
+typedef struct HTTPPoolEntry {
+    char key[POOL_KEY_SIZE];
+    AVIOContext *pb;
+} HTTPPoolEntry;
+
+struct HTTPPool {
+    AVFormatContext *s;
+    /* if set, new connections are opened with it instead of io_open() */
+    AVIOInterruptCB int_cb;
+    AVMutex lock;
+    /* idle connections, least recently released first */
+    HTTPPoolEntry *idle;
+    int nb_idle;
+    int max_idle;
+};
+
+#if CONFIG_HTTP_PROTOCOL
+/* Connections can be shared between URLs with the same scheme, host and
+ * port; anything else is not pooled. */
+static int pool_key(char *key, int key_size, const char *url)
+{
+    char proto[POOL_PROTO_SIZE], hostname[POOL_HOST_SIZE];
+    int port;
+
+    av_url_split(proto, sizeof(proto), NULL, 0, hostname, sizeof(hostname),
+                 &port, NULL, 0, url);
+    if (strcmp(proto, "http") && strcmp(proto, "https"))
+        return AVERROR(EINVAL);
+    if (port < 0)
+        port = strcmp(proto, "https") ? 80 : 443;
+    snprintf(key, key_size, "%s://%s:%d", proto, hostname, port);
+    return 0;
+}
+
+static AVIOContext *pool_take(HTTPPool *pool, const char *key)
+{
+    AVIOContext *pb = NULL;
+
+    ff_mutex_lock(&pool->lock);
+    for (int i = pool->nb_idle - 1; i >= 0; i--) {
+        if (!strcmp(pool->idle[i].key, key)) {
+            pb = pool->idle[i].pb;
+            memmove(&pool->idle[i], &pool->idle[i + 1],
+                    (pool->nb_idle - i - 1) * sizeof(*pool->idle));
+            pool->nb_idle--;
+            break;
+        }
+    }
+    ff_mutex_unlock(&pool->lock);
+    return pb;
+}
+#endif
+
+HTTPPool *ff_http_pool_alloc(AVFormatContext *s, int max_idle)
+{
+    HTTPPool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+    pool->idle = av_calloc(FFMAX(max_idle, 1), sizeof(*pool->idle));
+    if (!pool->idle || ff_mutex_init(&pool->lock, NULL)) {
+        av_free(pool->idle);
+        av_free(pool);
+        return NULL;
+    }
+    pool->s        = s;
+    pool->max_idle = max_idle;
+    return pool;
+}
+
+void ff_http_pool_set_interrupt_callback(HTTPPool *pool, const AVIOInterruptCB *int_cb)
+{
+    pool->int_cb = *int_cb;
+}
+
+void ff_http_pool_free(HTTPPool **ppool)
+{
+    HTTPPool *pool = *ppool;
+
+    if (!pool)
+        return;
+    for (int i = 0; i < pool->nb_idle; i++)
+        ff_format_io_close(pool->s, &pool->idle[i].pb);
+    ff_mutex_destroy(&pool->lock);
+    av_free(pool->idle);
+    av_freep(ppool);
+}
+
+int ff_http_pool_open(HTTPPool *pool, AVIOContext **pb, const char *url,
+                      AVDictionary **options)
+{
+    AVFormatContext *s = pool->s;
+#if CONFIG_HTTP_PROTOCOL
+    char key[POOL_KEY_SIZE];
+
+    if (pool_key(key, sizeof(key), url) >= 0) {
+        AVIOContext *idle = pool_take(pool, key);
+
+        if (idle) {
+            URLContext *uc = ffio_geturlcontext(idle);
+            AVDictionary *tmp = NULL;
+            int ret;
+
+            /* Drop whatever the previous response left in the buffer. */
+            idle->buf_ptr = idle->buf_end = idle->buffer;
+            idle->pos         = 0;
+            idle->eof_reached = 0;
+            idle->error       = 0;
+
+            av_dict_copy(&tmp, *options, 0);
+            ret = ff_http_do_new_request2(uc, url, &tmp);
+            av_dict_free(&tmp);
+            if (ret >= 0) {
+                idle->seekable = uc->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
+                *pb = idle;
+                return 0;
+            }
+            ff_format_io_close(s, &idle);
+            if (ret == AVERROR_EXIT)
+                return ret;
+            av_log(s, AV_LOG_VERBOSE,
+                   "Reusing connection for '%s' failed (%s), opening a new one\n",
+                   url, av_err2str(ret));
+        }
+        av_dict_set(options, "multiple_requests", "1", 0);
+    }
+#endif
+
+    if (pool->int_cb.callback)
+        return ffio_open_whitelist(pb, url, AVIO_FLAG_READ, &pool->int_cb, options,
+                                   s->protocol_whitelist, s->protocol_blacklist);
+    return s->io_open(s, pb, url, AVIO_FLAG_READ, options);
+}
+
+void ff_http_pool_release(HTTPPool *pool, AVIOContext **pb)
+{
+    AVIOContext *evicted = NULL;
+    char key[POOL_KEY_SIZE];
+    int reusable = 0;
+
+    if (!*pb)
+        return;
+
+#if CONFIG_HTTP_PROTOCOL
+    {
+        URLContext *uc = ffio_geturlcontext(*pb);
+        uint8_t *location = NULL;
+
+        reusable = pool->max_idle > 0 && uc && ff_http_connection_reusable(uc) &&
+                   av_opt_get(*pb, "location", AV_OPT_SEARCH_CHILDREN, &location) >= 0 &&
+                   pool_key(key, sizeof(key), location) >= 0;
+        av_free(location);
+    }
+#endif
+
+    if (!reusable) {
+        ff_format_io_close(pool->s, pb);
+        return;
+    }
+
+    ff_mutex_lock(&pool->lock);
+    if (pool->nb_idle == pool->max_idle) {
+        evicted = pool->idle[0].pb;
+        memmove(&pool->idle[0], &pool->idle[1],
+                (pool->nb_idle - 1) * sizeof(*pool->idle));
+        pool->nb_idle--;
+    }
+    av_strlcpy(pool->idle[pool->nb_idle].key, key, sizeof(key));
+    pool->idle[pool->nb_idle].pb = *pb;
+    pool->nb_idle++;
+    ff_mutex_unlock(&pool->lock);
+
+    *pb = NULL;
+    ff_format_io_close(pool->s, &evicted);
+}
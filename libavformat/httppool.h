@@ -0,0 +1,81 @@
+/*
+ * Shared pool of persistent HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTPPOOL_H
+#define AVFORMAT_HTTPPOOL_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * A set of idle keep-alive HTTP connections, keyed by scheme, host and
+ * port. Segment based demuxers open their requests through the pool and
+ * hand the connections back once a response has been read, so that the
+ * next request to the same server skips the TCP and TLS handshakes.
+ *
+ * All functions may be called from several threads at once.
+ */
+typedef struct HTTPPool HTTPPool;
+
+/**
+ * Allocate a connection pool.
+ *
+ * @param s        context whose io_open() and io_close2() callbacks are used
+ *                 to open and close connections
+ * @param max_idle maximum number of idle connections kept open
+ * @return the pool or NULL on allocation failure
+ */
+HTTPPool *ff_http_pool_alloc(AVFormatContext *s, int max_idle);
+
+/**
+ * Open new connections with the given interrupt callback instead of the
+ * io_open() callback of the context. Only valid if the context uses the
+ * default I/O callbacks. Must be called before any connection is opened.
+ */
+void ff_http_pool_set_interrupt_callback(HTTPPool *pool, const AVIOInterruptCB *int_cb);
+
+/**
+ * Close all idle connections and free the pool.
+ */
+void ff_http_pool_free(HTTPPool **pool);
+
+/**
+ * Open a URL for reading, reusing an idle connection to the same server
+ * when one is available. URLs that are not plain http or https are opened
+ * with io_open() as usual.
+ *
+ * @param pb      pointer to be set to the opened AVIOContext
+ * @param url     URL to open
+ * @param options options passed to io_open(), or to the reused connection
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_http_pool_open(HTTPPool *pool, AVIOContext **pb, const char *url,
+                      AVDictionary **options);
+
+/**
+ * Give a connection back to the pool. It is kept open only if its last
+ * response has been read completely, otherwise it is closed. *pb is set
+ * to NULL in either case.
+ */
+void ff_http_pool_release(HTTPPool *pool, AVIOContext **pb);
+
+#endif /* AVFORMAT_HTTPPOOL_H */
@@ -0,0 +1,298 @@
+/*
+ * Persistent seek index cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The cache file is a sequence of big-endian fields:
+ *
+ *   "FIDX" version:32 input_size:64 fingerprint:32 format_name:str nb_streams:32
+ *   for each stream:
+ *     index:32 id:32 codec_type:32 time_base.num:32 time_base.den:32
+ *     nb_entries:32
+ *     for each entry:
+ *       pos:64 timestamp:64 flags:2|size:30 min_distance:32
+ *   "FEND"
+ *
+ * The fingerprint is a CRC of the first and last FINGERPRINT_SIZE bytes of the
+ * input, so that an input replaced by a different file of the same size is
+ * not mistaken for the cached one.
+ *
+ * The trailing tag guards against files truncated by an interrupted write;
+ * the cache is also written to a temporary file and renamed into place.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "demux.h"
+#include "internal.h"
+
+#define INDEX_CACHE_VERSION 2
+#define FINGERPRINT_SIZE    (64 << 10)
+
+/* Demuxers with their own read_seek() keep private state tied to their index
+ * entries, so only formats relying on the generic seek code are cached. */
+static int index_cache_supported(const AVFormatContext *s)
+{
+    const FFInputFormat *const ifmt = ffifmt(s->iformat);
+
+    return s->pb && (s->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+           !ifmt->read_seek && !ifmt->read_seek2;
+}
+
+static int input_fingerprint(AVFormatContext *s, int64_t input_size, uint32_t *fingerprint)
+{
+    const AVCRC *const crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    const int size     = FFMIN(input_size, FINGERPRINT_SIZE);
+    const int64_t pos  = avio_tell(s->pb);
+    uint32_t crc = UINT32_MAX;
+    uint8_t *buf;
+    int ret = 0;
+
+    buf = av_malloc(size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < 2; i++) {
+        if (avio_seek(s->pb, i ? input_size - size : 0, SEEK_SET) < 0) {
+            ret = AVERROR(EIO);
+            break;
+        }
+        ret = ffio_read_size(s->pb, buf, size);
+        if (ret < 0)
+            break;
+        crc = av_crc(crc_table, crc, buf, size);
+    }
+    av_free(buf);
+
+    /* leave the input where the demuxer expects it */
+    if (avio_seek(s->pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    *fingerprint = crc;
+    return ret < 0 ? ret : 0;
+}
+
+static int count_cached_entries(AVFormatContext *s)
+{
+    int nb_entries = 0;
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        const FFStream *const sti = ffstream(s->streams[i]);
+        if (!sti->index_cache_skip)
+            nb_entries += sti->nb_index_entries;
+    }
+    return nb_entries;
+}
+
+static int read_index_cache(AVFormatContext *s, AVIOContext *pb, int64_t input_size,
+                            uint32_t fingerprint)
+{
+    char name[64];
+    unsigned nb_streams;
+
+    if (avio_rb32(pb) != MKBETAG('F','I','D','X') ||
+        avio_rb32(pb) != INDEX_CACHE_VERSION)
+        return AVERROR_INVALIDDATA;
+    if (avio_rb64(pb) != input_size || avio_rb32(pb) != fingerprint)
+        return AVERROR(EINVAL);
+    avio_get_str(pb, INT_MAX, name, sizeof(name));
+    if (strcmp(name, s->iformat->name))
+        return AVERROR(EINVAL);
+
+    nb_streams = avio_rb32(pb);
+    if (nb_streams > s->max_streams)
+        return AVERROR_INVALIDDATA;
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        unsigned index = avio_rb32(pb);
+        int id         = avio_rb32(pb);
+        int codec_type = avio_rb32(pb);
+        AVRational tb;
+        unsigned nb_entries;
+        AVStream *st = NULL;
+
+        tb.num     = avio_rb32(pb);
+        tb.den     = avio_rb32(pb);
+        nb_entries = avio_rb32(pb);
+        if (avio_feof(pb))
+            return AVERROR_INVALIDDATA;
+
+        /* Streams created after read_header() are skipped, as are streams
+         * whose index the demuxer built itself. */
+        if (index < s->nb_streams) {
+            st = s->streams[index];
+            if (st->id != id || st->codecpar->codec_type != codec_type ||
+                av_cmp_q(st->time_base, tb))
+                return AVERROR(EINVAL);
+            if (ffstream(st)->index_cache_skip)
+                st = NULL;
+        }
+
+        for (unsigned j = 0; j < nb_entries; j++) {
+            int64_t pos       = avio_rb64(pb);
+            int64_t timestamp = avio_rb64(pb);
+            unsigned fsize    = avio_rb32(pb);
+            int min_distance  = avio_rb32(pb);
+
+            if (avio_feof(pb))
+                return AVERROR_INVALIDDATA;
+            if (st && av_add_index_entry(st, pos, timestamp, fsize & 0x3FFFFFFF,
+                                         min_distance, fsize >> 30) < 0)
+                return AVERROR_INVALIDDATA;
+        }
+    }
+
+    if (avio_rb32(pb) != MKBETAG('F','E','N','D'))
+        return AVERROR_INVALIDDATA;
+    return 0;
+}
+
+int ff_index_cache_load(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    const FFInputFormat *const ifmt = ffifmt(s->iformat);
+    AVIOContext *pb = NULL;
+    int64_t input_size;
+    uint32_t fingerprint;
+    int ret;
+
+    if (!index_cache_supported(s))
+        return 0;
+    input_size = avio_size(s->pb);
+    if (input_size <= 0)
+        return 0;
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        FFStream *const sti = ffstream(s->streams[i]);
+        sti->index_cache_skip = sti->nb_index_entries > 0;
+    }
+
+    /* Formats seeking by bisection only learn keyframe positions while
+     * searching; also index the keyframes seen during normal demuxing. */
+    si->index_cache_record = !(s->iformat->flags & AVFMT_GENERIC_INDEX) &&
+                             ifmt->read_timestamp;
+
+    ret = s->io_open(s, &pb, s->index_cache, AVIO_FLAG_READ, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_DEBUG, "No index cache at '%s'\n", s->index_cache);
+        return 0;
+    }
+
+    ret = input_fingerprint(s, input_size, &fingerprint);
+    if (ret >= 0)
+        ret = read_index_cache(s, pb, input_size, fingerprint);
+    ff_format_io_close(s, &pb);
+
+    if (ret < 0) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring %s index cache '%s'\n",
+               ret == AVERROR(EINVAL) ? "stale" : "invalid", s->index_cache);
+        for (unsigned i = 0; i < s->nb_streams; i++) {
+            FFStream *const sti = ffstream(s->streams[i]);
+            if (!sti->index_cache_skip) {
+                av_freep(&sti->index_entries);
+                sti->nb_index_entries = 0;
+                sti->index_entries_allocated_size = 0;
+            }
+        }
+        return 0;
+    }
+
+    si->index_cache_entries = count_cached_entries(s);
+    av_log(s, AV_LOG_VERBOSE, "Restored %d index entries from '%s'\n",
+           si->index_cache_entries, s->index_cache);
+    return 0;
+}
+
+int ff_index_cache_save(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    AVIOContext *pb = NULL;
+    char *tmp_name;
+    int64_t input_size;
+    uint32_t fingerprint;
+    int nb_streams = 0, nb_entries;
+    int ret;
+
+    if (!index_cache_supported(s))
+        return 0;
+    nb_entries = count_cached_entries(s);
+    if (!nb_entries || nb_entries == si->index_cache_entries)
+        return 0;
+    input_size = avio_size(s->pb);
+    if (input_size <= 0)
+        return 0;
+    ret = input_fingerprint(s, input_size, &fingerprint);
+    if (ret < 0)
+        return ret;
+
+    tmp_name = av_asprintf("%s.tmp", s->index_cache);
+    if (!tmp_name)
+        return AVERROR(ENOMEM);
+
+    ret = s->io_open(s, &pb, tmp_name, AVIO_FLAG_WRITE, NULL);
+    if (ret < 0)
+        goto end;
+
+    for (unsigned i = 0; i < s->nb_streams; i++)
+        nb_streams += !ffstream(s->streams[i])->index_cache_skip;
+
+    avio_wb32(pb, MKBETAG('F','I','D','X'));
+    avio_wb32(pb, INDEX_CACHE_VERSION);
+    avio_wb64(pb, input_size);
+    avio_wb32(pb, fingerprint);
+    avio_put_str(pb, s->iformat->name);
+    avio_wb32(pb, nb_streams);
+
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        const AVStream *const st  = s->streams[i];
+        const FFStream *const sti = cffstream(st);
+
+        if (sti->index_cache_skip)
+            continue;
+        avio_wb32(pb, st->index);
+        avio_wb32(pb, st->id);
+        avio_wb32(pb, st->codecpar->codec_type);
+        avio_wb32(pb, st->time_base.num);
+        avio_wb32(pb, st->time_base.den);
+        avio_wb32(pb, sti->nb_index_entries);
+        for (int j = 0; j < sti->nb_index_entries; j++) {
+            const AVIndexEntry *const e = &sti->index_entries[j];
+            avio_wb64(pb, e->pos);
+            avio_wb64(pb, e->timestamp);
+            avio_wb32(pb, ((unsigned)e->flags & 3) << 30 | e->size);
+            avio_wb32(pb, e->min_distance);
+        }
+    }
+    avio_wb32(pb, MKBETAG('F','E','N','D'));
+
+    ret = ff_format_io_close(s, &pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp_name, s->index_cache, s);
+    if (ret >= 0)
+        av_log(s, AV_LOG_VERBOSE, "Wrote %d index entries to '%s'\n",
+               nb_entries, s->index_cache);
+
+end:
+    av_free(tmp_name);
+    return ret;
+}
@@ -183,6 +183,19 @@ typedef struct FFFormatContext {
      * Contexts and child contexts do not contain a metadata option
      */
     int metafree;
+
+    /**
+     * Number of index entries restored from AVFormatContext.index_cache,
+     * used to skip rewriting an unchanged cache on close.
+     */
+    int index_cache_entries;
+
+    /**
+     * Add keyframes to the index while demuxing so that they end up in
+     * AVFormatContext.index_cache, for formats that would otherwise only
+     * index the positions found by seeking.
+     */
+    int index_cache_record;
 } FFFormatContext;
 
 static av_always_inline FFFormatContext *ffformatcontext(AVFormatContext *s)
@@ -251,6 +264,12 @@ typedef struct FFStream {
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
 
+    /**
+     * Set if the index was built by the demuxer in read_header() and is
+     * therefore neither restored from nor written to the index cache.
+     */
+    int index_cache_skip;
+
     int64_t interleaver_chunk_size;
     int64_t interleaver_chunk_duration;
 
@@ -715,6 +734,12 @@ int ff_copy_whiteblacklists(AVFormatContext *dst, const AVFormatContext *src);
  */
 int ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * @return 1 if the io_open() and io_close2() callbacks of s are the ones
+ *         set by avformat_alloc_context(), 0 otherwise
+ */
+int ff_format_io_is_default(const AVFormatContext *s);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
@@ -330,6 +330,8 @@ typedef struct MOVContext {
     int use_mfra_for;
     int has_looked_for_mfra;
     int use_tfdt;
+    int lazy_frag_index;    ///< only read fragment headers when reading or seeking reaches them
+    int64_t fragment_duration; ///< duration from mehd, in movie timescale
     MOVFragmentIndex frag_index;
     int atom_depth;
     unsigned int aax_mode;  ///< 'aax' file has been detected
@@ -40,6 +40,7 @@
 #include "libavutil/dict.h"
 #include "libavutil/dict_internal.h"
 #include "libavutil/display.h"
+#include "libavutil/executor.h"
 #include "libavutil/hdr_dynamic_metadata.h"
 #include "libavutil/intfloat.h"
 #include "libavutil/intreadwrite.h"
@@ -51,6 +52,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/defs.h"
@@ -384,6 +386,22 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+/* Maximum number of blocks being decompressed ahead per decode thread. */
+#define DECODE_JOBS_PER_THREAD 4
+#define MAX_DECODE_THREADS     64
+
+/* Decompression of one queued packet, run on a worker thread. */
+typedef struct MatroskaDecodeJob {
+    AVTask task;
+    struct MatroskaDecodeJob *next;
+    const MatroskaTrack *track;
+    AVPacket *pkt;
+    int nb_blockmore;
+    unsigned seq;
+    int done;
+    int ret;
+} MatroskaDecodeJob;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -439,6 +457,17 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Off-thread decompression of compressed tracks. Jobs are kept in
+     * submission order, which is also their order in the packet queue,
+     * and a queued packet waiting for its job points to it via opaque. */
+    int decode_threads;
+    AVExecutor *executor;
+    AVMutex decode_lock;
+    AVCond  decode_cond;
+    MatroskaDecodeJob *jobs_head, *jobs_tail;
+    int nb_jobs;
+    unsigned job_seq;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1674,9 +1703,9 @@ static MatroskaTrack *matroska_find_track_by_num(MatroskaDemuxContext *matroska,
 }
 
 static int matroska_decode_buffer(uint8_t **buf, int *buf_size,
-                                  MatroskaTrack *track)
+                                  const MatroskaTrack *track)
 {
-    MatroskaTrackEncoding *encodings = track->encodings.elem;
+    const MatroskaTrackEncoding *encodings = track->encodings.elem;
     uint8_t *data = *buf;
     int isize = *buf_size;
     uint8_t *pkt_data = NULL;
@@ -1692,7 +1721,7 @@ static int matroska_decode_buffer(uint8_t **buf, int *buf_size,
     case MATROSKA_TRACK_ENCODING_COMP_HEADERSTRIP:
     {
         int header_size = encodings[0].compression.settings.size;
-        uint8_t *header = encodings[0].compression.settings.data;
+        const uint8_t *header = encodings[0].compression.settings.data;
 
         if (header_size && !header) {
             av_log(NULL, AV_LOG_ERROR, "Compression size but no data in headerstrip\n");
@@ -3294,6 +3323,131 @@ static int matroska_parse_tracks(AVFormatContext *s)
     return 0;
 }
 
+static int decode_job_priority_higher(const AVTask *a, const AVTask *b)
+{
+    return ((const MatroskaDecodeJob *)a)->seq < ((const MatroskaDecodeJob *)b)->seq;
+}
+
+static int decode_job_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+static int decode_job_run(AVTask *t, void *local_context, void *user_data)
+{
+    MatroskaDemuxContext *matroska = user_data;
+    MatroskaDecodeJob *job = (MatroskaDecodeJob *)t;
+    AVPacket *pkt = job->pkt;
+    uint8_t *data = pkt->data;
+    int size = pkt->size;
+    int ret;
+
+    ret = matroska_decode_buffer(&data, &size, job->track);
+    if (ret >= 0) {
+        AVBufferRef *buf = av_buffer_create(data, size + AV_INPUT_BUFFER_PADDING_SIZE,
+                                            NULL, NULL, 0);
+        if (buf) {
+            av_buffer_unref(&pkt->buf);
+            pkt->buf  = buf;
+            pkt->data = data;
+            pkt->size = size;
+        } else {
+            av_free(data);
+            ret = AVERROR(ENOMEM);
+        }
+    }
+
+    ff_mutex_lock(&matroska->decode_lock);
+    job->ret  = ret;
+    job->done = 1;
+    ff_cond_broadcast(&matroska->decode_cond);
+    ff_mutex_unlock(&matroska->decode_lock);
+    return 0;
+}
+
+static int matroska_init_decode_threads(MatroskaDemuxContext *matroska)
+{
+    const AVTaskCallbacks callbacks = {
+        .user_data       = matroska,
+        .priority_higher = decode_job_priority_higher,
+        .ready           = decode_job_ready,
+        .run             = decode_job_run,
+    };
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int i, ret;
+
+    for (i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].needs_decoding)
+            break;
+    if (i == matroska->tracks.nb_elem)
+        return 0;
+
+    if ((ret = ff_mutex_init(&matroska->decode_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_cond_init(&matroska->decode_cond, NULL))) {
+        ff_mutex_destroy(&matroska->decode_lock);
+        return AVERROR(ret);
+    }
+    matroska->executor = av_executor_alloc(&callbacks, matroska->decode_threads);
+    if (!matroska->executor) {
+        ff_cond_destroy(&matroska->decode_cond);
+        ff_mutex_destroy(&matroska->decode_lock);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/* Queue decompression of the packet just added to the packet queue. */
+static int matroska_submit_decode(MatroskaDemuxContext *matroska,
+                                  const MatroskaTrack *track, int nb_blockmore)
+{
+    MatroskaDecodeJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->track = track;
+    job->pkt   = &matroska->queue.tail->pkt;
+    job->nb_blockmore = nb_blockmore;
+    job->seq   = matroska->job_seq++;
+    job->pkt->opaque = job;
+
+    if (matroska->jobs_tail)
+        matroska->jobs_tail->next = job;
+    else
+        matroska->jobs_head = job;
+    matroska->jobs_tail = job;
+    matroska->nb_jobs++;
+
+    av_executor_execute(matroska->executor, &job->task);
+    return 0;
+}
+
+/* Wait for the oldest job to finish and release it. Returns 1 if the
+ * block decompressed to nothing and must be dropped, like the inline
+ * path does in matroska_parse_frame(). */
+static int matroska_finish_decode(MatroskaDemuxContext *matroska)
+{
+    MatroskaDecodeJob *job = matroska->jobs_head;
+    int ret;
+
+    ff_mutex_lock(&matroska->decode_lock);
+    while (!job->done)
+        ff_cond_wait(&matroska->decode_cond, &matroska->decode_lock);
+    ff_mutex_unlock(&matroska->decode_lock);
+
+    job->pkt->opaque = NULL;
+    ret = job->ret;
+    if (!ret && !job->pkt->size && !job->nb_blockmore)
+        ret = 1;
+
+    matroska->jobs_head = job->next;
+    if (!matroska->jobs_head)
+        matroska->jobs_tail = NULL;
+    matroska->nb_jobs--;
+    av_free(job);
+    return ret;
+}
+
 static int matroska_read_header(AVFormatContext *s)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -3443,6 +3597,9 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    if (matroska->decode_threads > 0)
+        return matroska_init_decode_threads(matroska);
+
     return 0;
 }
 
@@ -3453,10 +3610,23 @@ static int matroska_read_header(AVFormatContext *s)
 static int matroska_deliver_packet(MatroskaDemuxContext *matroska,
                                    AVPacket *pkt)
 {
-    if (matroska->queue.head) {
+    while (matroska->queue.head) {
         MatroskaTrack *tracks = matroska->tracks.elem;
         MatroskaTrack *track;
 
+        if (matroska->queue.head->pkt.opaque) {
+            int ret = matroska_finish_decode(matroska);
+            if (ret) {
+                avpriv_packet_list_get(&matroska->queue, pkt);
+                if (ret < 0)
+                    av_log(matroska->ctx, AV_LOG_ERROR,
+                           "Failed to decode block of stream %d, dropping it\n",
+                           pkt->stream_index);
+                av_packet_unref(pkt);
+                continue;
+            }
+        }
+
         avpriv_packet_list_get(&matroska->queue, pkt);
         track = &tracks[pkt->stream_index];
         if (track->has_palette) {
@@ -3479,6 +3649,8 @@ static int matroska_deliver_packet(MatroskaDemuxContext *matroska,
  */
 static void matroska_clear_queue(MatroskaDemuxContext *matroska)
 {
+    while (matroska->jobs_head)
+        matroska_finish_decode(matroska);
     avpriv_packet_list_free(&matroska->queue);
 }
 
@@ -4193,7 +4365,15 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         uint8_t *out_data = data;
         int      out_size = lace_size[n];
 
-        if (track->needs_decoding) {
+        /* Plain frames can be queued as they are and decompressed in place
+         * on a worker thread; the other paths need the decoded data now. */
+        int async = track->needs_decoding && matroska->executor && out_size &&
+                    !track->audio.buf &&
+                    st->codecpar->codec_id != AV_CODEC_ID_WEBVTT &&
+                    st->codecpar->codec_id != AV_CODEC_ID_WAVPACK &&
+                    st->codecpar->codec_id != AV_CODEC_ID_PRORES;
+
+        if (track->needs_decoding && !async) {
             res = matroska_decode_buffer(&out_data, &out_size, track);
             if (res < 0)
                 return res;
@@ -4204,7 +4384,19 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
             buf = NULL;
         }
 
-        if (track->audio.buf) {
+        if (async) {
+            PacketListEntry *tail = matroska->queue.tail;
+
+            res = matroska_parse_frame(matroska, track, st, buf, out_data,
+                                       out_size, timecode, lace_duration,
+                                       pos, !n ? is_keyframe : 0,
+                                       blockmore, nb_blockmore,
+                                       discard_padding);
+            if (!res && matroska->queue.tail != tail)
+                res = matroska_submit_decode(matroska, track, nb_blockmore);
+            if (res)
+                return res;
+        } else if (track->audio.buf) {
             res = matroska_parse_rm_audio(matroska, track, st,
                                           out_data, out_size,
                                           timecode, pos);
@@ -4303,6 +4495,15 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
         matroska->resync_pos = avio_tell(s->pb);
     }
 
+    /* Keep the decode threads busy by reading ahead while the next
+     * packet is still being decompressed. */
+    while (matroska->queue.head && matroska->queue.head->pkt.opaque &&
+           matroska->nb_jobs < DECODE_JOBS_PER_THREAD * matroska->decode_threads &&
+           !matroska->done) {
+        if (matroska_parse_cluster(matroska) < 0 && !matroska->done)
+            ret = matroska_resync(matroska, matroska->resync_pos);
+    }
+
     while (matroska_deliver_packet(matroska, pkt)) {
         if (matroska->done)
             return (ret < 0) ? ret : AVERROR_EOF;
@@ -4388,6 +4589,11 @@ static int matroska_read_close(AVFormatContext *s)
     int n;
 
     matroska_clear_queue(matroska);
+    if (matroska->executor) {
+        av_executor_free(&matroska->executor);
+        ff_cond_destroy(&matroska->decode_cond);
+        ff_mutex_destroy(&matroska->decode_lock);
+    }
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
@@ -4397,6 +4603,8 @@ static int matroska_read_close(AVFormatContext *s)
     return 0;
 }
 
+#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
+
 #if CONFIG_WEBM_DASH_MANIFEST_DEMUXER
 typedef struct {
     int64_t start_time_ns;
@@ -4815,7 +5023,6 @@ static int webm_dash_manifest_read_packet(AVFormatContext *s, AVPacket *pkt)
     return AVERROR_EOF;
 }
 
-#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
 static const AVOption options[] = {
     { "live", "flag indicating that the input is a live file that only has the headers.", OFFSET(is_live), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "bandwidth", "bandwidth of this stream to be specified in the DASH manifest.", OFFSET(bandwidth), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
@@ -4841,11 +5048,25 @@ const FFInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+static const AVOption matroska_options[] = {
+    { "decode_threads", "number of threads decompressing compressed tracks (0 to decompress inline)",
+      OFFSET(decode_threads), AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_DECODE_THREADS, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFInputFormat ff_matroska_demuxer = {
     .p.name         = "matroska,webm",
     .p.long_name    = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .p.extensions   = "mkv,mk3d,mka,mks,webm",
     .p.mime_type    = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .p.priv_class   = &matroska_class,
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .flags_internal = FF_INFMT_FLAG_INIT_CLEANUP,
     .read_probe     = matroska_probe,
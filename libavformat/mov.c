@@ -5528,6 +5528,14 @@ static int mov_read_chap(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0;
 }
 
+static int mov_read_mehd(MOVContext *c, AVIOContext *pb, MOVAtom atom)
+{
+    int version = avio_r8(pb);
+    avio_rb24(pb); /* flags */
+    c->fragment_duration = version == 1 ? avio_rb64(pb) : avio_rb32(pb);
+    return 0;
+}
+
 static int mov_read_trex(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 {
     MOVTrackExt *trex;
@@ -9073,6 +9081,7 @@ static const MOVParseTableEntry mov_default_parse_table[] = {
 { MKTAG('t','m','c','d'), mov_read_tmcd },
 { MKTAG('c','h','a','p'), mov_read_chap },
 { MKTAG('t','r','e','x'), mov_read_trex },
+{ MKTAG('m','e','h','d'), mov_read_mehd },
 { MKTAG('t','r','u','n'), mov_read_trun },
 { MKTAG('u','d','t','a'), mov_read_default },
 { MKTAG('w','a','v','e'), mov_read_wave },
@@ -9227,14 +9236,17 @@ static int mov_read_default(MOVContext *c, AVIOContext *pb, MOVAtom atom)
             int64_t start_pos = avio_tell(pb);
             int64_t left;
             int err = parse(c, pb, a);
+            int incremental;
             if (err < 0) {
                 c->atom_depth --;
                 return err;
             }
+            /* read further fragments only when they are needed */
+            incremental = !(pb->seekable & AVIO_SEEKABLE_NORMAL) || c->fc->flags & AVFMT_FLAG_IGNIDX ||
+                          c->frag_index.complete || (c->lazy_frag_index && c->fragment.moof_offset);
             if (c->found_moov && c->found_mdat && a.size <= INT64_MAX - start_pos &&
-                ((!(pb->seekable & AVIO_SEEKABLE_NORMAL) || c->fc->flags & AVFMT_FLAG_IGNIDX || c->frag_index.complete) ||
-                 start_pos + a.size == avio_size(pb))) {
-                if (!(pb->seekable & AVIO_SEEKABLE_NORMAL) || c->fc->flags & AVFMT_FLAG_IGNIDX || c->frag_index.complete)
+                (incremental || start_pos + a.size == avio_size(pb))) {
+                if (incremental)
                     c->next_root_atom = start_pos + a.size;
                 c->atom_depth --;
                 return 0;
@@ -10278,6 +10290,11 @@ static int mov_read_header(AVFormatContext *s)
         if (mov->frag_index.item[i].moof_offset <= mov->fragment.moof_offset)
             mov->frag_index.item[i].headers_read = 1;
 
+    /* the fragments read so far do not cover the whole file */
+    if (mov->lazy_frag_index && mov->next_root_atom && mov->fragment_duration > 0 &&
+        s->duration == AV_NOPTS_VALUE && mov->time_scale > 0)
+        s->duration = av_rescale(mov->fragment_duration, AV_TIME_BASE, mov->time_scale);
+
     return 0;
 }
 
@@ -10584,13 +10601,34 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+/**
+ * With lazy_frag_index, read the headers of the following fragments until
+ * the index of st reaches timestamp or the end of the file.
+ */
+static int mov_read_fragments_until(AVFormatContext *s, AVStream *st, int64_t timestamp)
+{
+    MOVContext *mov = s->priv_data;
+    FFStream *const sti = ffstream(st);
+
+    while (mov->next_root_atom &&
+           (!sti->nb_index_entries ||
+            sti->index_entries[sti->nb_index_entries - 1].timestamp < timestamp)) {
+        int ret = mov_switch_root(s, mov->next_root_atom, -1);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp)
 {
     MOVContext *mov = s->priv_data;
     int index;
 
     if (!mov->frag_index.complete)
-        return 0;
+        return mov->lazy_frag_index ? mov_read_fragments_until(s, st, timestamp) : 0;
 
     index = search_frag_timestamp(s, &mov->frag_index, st, timestamp);
     if (index < 0)
@@ -10823,6 +10861,8 @@ static const AVOption mov_options[] = {
         FLAGS, .unit = "use_mfra_for" },
     {"use_tfdt", "use tfdt for fragment timestamps", OFFSET(use_tfdt), AV_OPT_TYPE_BOOL, {.i64 = 1},
         0, 1, FLAGS},
+    {"lazy_frag_index", "read fragment headers only when reading or seeking reaches them",
+        OFFSET(lazy_frag_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS},
     { "export_all", "Export unrecognized metadata entries", OFFSET(export_all),
         AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, .flags = FLAGS },
     { "export_xmp", "Export full XMP metadata", OFFSET(export_xmp),
@@ -7648,7 +7648,7 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
-    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+    if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->reserved_moov_size) {
         mov->reserved_moov_size = -1;
     }
 
@@ -8162,7 +8162,7 @@ static int mov_write_header(AVFormatContext *s)
             mov->mdat_pos = avio_tell(pb);
         }
     } else if (mov->mode != MODE_AVIF) {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -8296,6 +8296,46 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
+/*
+ * Make sure the moov atom and a trailing free atom fit into the space
+ * reserved with moov_size, by shifting the data after the reserved space
+ * if the estimate was too small. Returns the number of bytes the data was
+ * shifted by.
+ */
+static int grow_reserved_moov(AVFormatContext *s)
+{
+    int i, ret, shift, moov_size, moov_size2;
+    MOVMuxContext *mov = s->priv_data;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+    if (moov_size + 8 <= mov->reserved_moov_size)
+        return 0;
+
+    /* the shift size is also the copy block size, so don't make it tiny */
+    shift = FFALIGN(moov_size + 8 - mov->reserved_moov_size, 4096);
+    for (i = 0; i < mov->nb_tracks; i++)
+        mov->tracks[i].data_offset += shift;
+
+    moov_size2 = get_moov_size(s);
+    if (moov_size2 < 0)
+        return moov_size2;
+    if (moov_size2 != moov_size) {
+        for (i = 0; i < mov->nb_tracks; i++)
+            mov->tracks[i].data_offset += moov_size2 - moov_size;
+        shift += moov_size2 - moov_size;
+    }
+
+    av_log(s, AV_LOG_WARNING, "moov_size is too small, needed %d additional bytes; "
+           "starting second pass to grow the reserved space\n", shift);
+    ret = ff_format_shift_data(s, mov->reserved_header_pos, shift);
+    if (ret < 0)
+        return ret;
+    mov->reserved_moov_size += shift;
+    return shift;
+}
+
 static int shift_data(AVFormatContext *s)
 {
     int moov_size;
@@ -8403,7 +8443,7 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -8413,6 +8453,14 @@ static int mov_write_trailer(AVFormatContext *s)
                 return res;
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
+            if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+                /* the data to shift ends at the current position */
+                avio_seek(pb, moov_pos, SEEK_SET);
+                if ((res = grow_reserved_moov(s)) < 0)
+                    return res;
+                moov_pos += res;
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+            }
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
             size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
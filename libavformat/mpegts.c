@@ -101,6 +101,7 @@ struct MpegTSFilter {
     int last_cc; /* last cc code (-1 if first packet) */
     int64_t last_pcr;
     int discard;
+    unsigned discard_gen; /* MpegTSContext.discard_gen discard was computed for */
     enum MpegTSFilterType type;
     union {
         MpegTSPESFilter pes_filter;
@@ -174,6 +175,12 @@ struct MpegTSContext {
     unsigned int nb_prg;
     struct Program *prg;
 
+    /** bumped whenever the result of discard_pid() may have changed */
+    unsigned discard_gen;
+    /** whether each AVProgram was discarded as of the last discard_gen bump */
+    uint8_t *prg_discard;
+    int nb_prg_discard;
+
     int8_t crc_validity[NB_PID_MAX];
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
@@ -416,6 +423,31 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+/**
+ * Invalidate the per-PID discard flags if the caller changed which programs
+ * are discarded, so that discard_pid() only runs again when it may return a
+ * different result. Program layout changes are handled in pat_cb()/pmt_cb().
+ */
+static void update_discard_gen(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int changed = s->nb_programs != ts->nb_prg_discard;
+
+    for (unsigned k = 0; !changed && k < s->nb_programs; k++)
+        changed = ts->prg_discard[k] != (s->programs[k]->discard == AVDISCARD_ALL);
+    if (!changed)
+        return;
+
+    if (av_reallocp(&ts->prg_discard, s->nb_programs) < 0) {
+        ts->nb_prg_discard = -1;
+    } else {
+        for (unsigned k = 0; k < s->nb_programs; k++)
+            ts->prg_discard[k] = s->programs[k]->discard == AVDISCARD_ALL;
+        ts->nb_prg_discard = s->nb_programs;
+    }
+    ts->discard_gen++;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -506,6 +538,7 @@ static MpegTSFilter *mpegts_open_filter(MpegTSContext *ts, unsigned int pid,
     filter->es_id   = -1;
     filter->last_cc = -1;
     filter->last_pcr= -1;
+    filter->discard_gen = ts->discard_gen - 1;
 
     return filter;
 }
@@ -2349,6 +2382,7 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         return;
     if (skip_identical(h, tssf))
         return;
+    ts->discard_gen++;
 
     av_log(ts->stream, AV_LOG_TRACE, "sid=0x%x sec_num=%d/%d version=%d tid=%d\n",
             h->id, h->sec_num, h->last_sec_num, h->version, h->tid);
@@ -2563,6 +2597,7 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
     if (skip_identical(h, tssf))
         return;
+    ts->discard_gen++;
     ts->id = h->id;
 
     for (;;) {
@@ -2785,8 +2820,10 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     }
     if (!tss)
         return 0;
-    if (is_start)
-        tss->discard = discard_pid(ts, pid);
+    if (is_start && tss->discard_gen != ts->discard_gen) {
+        tss->discard     = discard_pid(ts, pid);
+        tss->discard_gen = ts->discard_gen;
+    }
     if (tss->discard)
         return 0;
     ts->current_pid = pid;
@@ -2975,6 +3012,35 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Handle a run of packets in place in the I/O buffer, without the per-packet
+ * read and position calls of read_packet(). The run ends before the first
+ * packet out of sync, which is left to the resync logic in read_packet().
+ *
+ * @return the number of packets handled, or a negative error code
+ */
+static int handle_packet_run(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const uint8_t *buf = pb->buf_ptr;
+    int64_t pos = avio_tell(pb);
+    int nb = FFMIN((pb->buf_end - buf) / TS_PACKET_SIZE, max_packets);
+    int i, ret = 0;
+
+    for (i = 0; i < nb && !ts->stop_parse;) {
+        const uint8_t *packet = buf + i * TS_PACKET_SIZE;
+        if (packet[0] != 0x47)
+            break;
+        i++;
+        ret = handle_packet(ts, packet, pos + i * TS_PACKET_SIZE);
+        if (ret != 0)
+            break;
+    }
+    if (i)
+        avio_skip(pb, i * TS_PACKET_SIZE);
+    return ret < 0 ? ret : i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -3003,6 +3069,8 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         }
     }
 
+    update_discard_gen(ts);
+
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
@@ -3016,6 +3084,17 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        if (ts->raw_packet_size == TS_PACKET_SIZE) {
+            ret = handle_packet_run(ts, nb_packets ? nb_packets - packet_num : INT_MAX);
+            if (ret < 0)
+                break;
+            if (ret > 0) {
+                packet_num += ret - 1;
+                ret = 0;
+                continue;
+            }
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3291,6 +3370,7 @@ static void mpegts_free(MpegTSContext *ts)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->prg_discard);
 
     for (i = 0; i < FF_ARRAY_ELEMS(ts->pools); i++)
         av_buffer_pool_uninit(&ts->pools[i]);
@@ -3411,6 +3491,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    update_discard_gen(ts);
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
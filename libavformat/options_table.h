@@ -109,6 +109,8 @@ static const AVOption avformat_options[] = {
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
 {"duration_probesize", "Maximum number of bytes to probe the durations of the streams in estimate_timings_from_pts", OFFSET(duration_probesize), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, INT64_MAX, D},
+{"index_cache", "path of a file used to persist the seek index across opens", OFFSET(index_cache), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+{"probe_threads", "number of threads decoding streams in parallel while probing", OFFSET(probe_threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, INT_MAX, D },
 {NULL},
 };
 
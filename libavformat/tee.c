@@ -20,10 +20,14 @@
  */
 
 
+#include "config.h"
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
 #include "libavcodec/bsf.h"
 #include "internal.h"
 #include "avformat.h"
@@ -37,6 +41,16 @@ typedef enum {
 
 #define DEFAULT_SLAVE_FAILURE_POLICY ON_SLAVE_FAILURE_ABORT
 
+typedef enum {
+    ON_SLAVE_FULL_BLOCK = 1,
+    ON_SLAVE_FULL_DROP  = 2
+} SlaveFullPolicy;
+
+typedef struct TeeMessage {
+    AVPacket *pkt;      ///< NULL to flush the slave
+    int64_t queued;     ///< time the message was queued, for latency statistics
+} TeeMessage;
+
 typedef struct {
     AVFormatContext *avf;
     AVBSFContext **bsfs; ///< bitstream filters per stream
@@ -49,6 +63,35 @@ typedef struct {
      * disabled output streams are set to -1 */
     int *stream_map;
     int header_written;
+
+    /* asynchronous writing, see start_slave_thread() */
+    int async;
+    int queue_size;
+    SlaveFullPolicy on_full;
+    AVThreadMessageQueue *queue;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_started;
+    int thread_ret;
+    /** per input stream flag, set after a packet was dropped */
+    uint8_t *wait_keyframe;
+
+    /* flushes are synchronous, see wait_slave_flush() */
+    AVMutex flush_lock;
+    AVCond flush_cond;
+    int flush_sync_init;
+    unsigned nb_flushes_sent;   ///< only accessed by the muxing thread
+    unsigned nb_flushes_done;   ///< protected by flush_lock
+    int thread_exited;          ///< protected by flush_lock
+
+    /* statistics, only read after the writer thread has been joined;
+     * nb_written and latency_* are updated by the writer thread,
+     * nb_dropped by the muxing thread */
+    int64_t nb_written;
+    int64_t nb_dropped;
+    int64_t latency_sum;
+    int64_t latency_max;
 } TeeSlave;
 
 typedef struct TeeContext {
@@ -58,6 +101,8 @@ typedef struct TeeContext {
     TeeSlave *slaves;
     int use_fifo;
     AVDictionary *fifo_options;
+    int async;
+    int queue_size;
 } TeeContext;
 
 static const char *const slave_delim     = "|";
@@ -70,6 +115,10 @@ static const AVOption options[] = {
          OFFSET(use_fifo), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
         {"fifo_options", "fifo pseudo-muxer options", OFFSET(fifo_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
+        {"async", "Write to each slave from its own thread",
+         OFFSET(async), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
+        {"queue_size", "Number of packets queued per slave in async mode",
+         OFFSET(queue_size), AV_OPT_TYPE_INT, {.i64 = 64}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
         {NULL}
 };
 
@@ -97,37 +146,92 @@ static inline int parse_slave_failure_policy_option(const char *opt, TeeSlave *t
     return AVERROR(EINVAL);
 }
 
-static int parse_slave_fifo_policy(const char *use_fifo, TeeSlave *tee_slave)
+static inline int parse_slave_full_policy_option(const char *opt, TeeSlave *tee_slave)
+{
+    if (!av_strcasecmp("block", opt)) {
+        tee_slave->on_full = ON_SLAVE_FULL_BLOCK;
+        return 0;
+    } else if (!av_strcasecmp("drop", opt)) {
+        tee_slave->on_full = ON_SLAVE_FULL_DROP;
+        return 0;
+    }
+    return AVERROR(EINVAL);
+}
+
+static int parse_slave_bool_option(const char *value, int *field)
 {
     /*TODO - change this to use proper function for parsing boolean
      *       options when there is one */
-    if (av_match_name(use_fifo, "true,y,yes,enable,enabled,on,1")) {
-        tee_slave->use_fifo = 1;
-    } else if (av_match_name(use_fifo, "false,n,no,disable,disabled,off,0")) {
-        tee_slave->use_fifo = 0;
+    if (av_match_name(value, "true,y,yes,enable,enabled,on,1")) {
+        *field = 1;
+    } else if (av_match_name(value, "false,n,no,disable,disabled,off,0")) {
+        *field = 0;
     } else {
         return AVERROR(EINVAL);
     }
     return 0;
 }
 
+static int parse_slave_queue_size(const char *value, TeeSlave *tee_slave)
+{
+    char *end;
+    long size = strtol(value, &end, 10);
+
+    if (*end || size < 1 || size > INT_MAX)
+        return AVERROR(EINVAL);
+    tee_slave->queue_size = size;
+    return 0;
+}
+
 static int parse_slave_fifo_options(const char *fifo_options, TeeSlave *tee_slave)
 {
     return av_dict_parse_string(&tee_slave->fifo_options, fifo_options, "=", ":", 0);
 }
 
+static int stop_slave_thread(TeeSlave *tee_slave)
+{
+    if (!tee_slave->queue)
+        return 0;
+
+    /* the writer thread drains the queue before it sees EOF */
+    av_thread_message_queue_set_err_recv(tee_slave->queue, AVERROR_EOF);
+#if HAVE_THREADS
+    if (tee_slave->thread_started)
+        pthread_join(tee_slave->thread, NULL);
+#endif
+    tee_slave->thread_started = 0;
+    av_thread_message_queue_free(&tee_slave->queue);
+    if (tee_slave->flush_sync_init) {
+        ff_cond_destroy(&tee_slave->flush_cond);
+        ff_mutex_destroy(&tee_slave->flush_lock);
+        tee_slave->flush_sync_init = 0;
+    }
+
+    av_log(tee_slave->avf, AV_LOG_VERBOSE, "Async slave statistics: %"PRId64" packets "
+           "written, %"PRId64" dropped, latency avg %"PRId64" us, max %"PRId64" us\n",
+           tee_slave->nb_written, tee_slave->nb_dropped,
+           tee_slave->nb_written ? tee_slave->latency_sum / tee_slave->nb_written : 0,
+           tee_slave->latency_max);
+    return tee_slave->thread_ret;
+}
+
 static int close_slave(TeeSlave *tee_slave)
 {
     AVFormatContext *avf;
-    int ret = 0;
+    int ret = 0, ret_thread;
 
     av_dict_free(&tee_slave->fifo_options);
+    av_freep(&tee_slave->wait_keyframe);
     avf = tee_slave->avf;
     if (!avf)
         return 0;
 
+    ret_thread = stop_slave_thread(tee_slave);
+
     if (tee_slave->header_written)
         ret = av_write_trailer(avf);
+    if (ret_thread < 0)
+        ret = ret_thread;
 
     if (tee_slave->bsfs) {
         for (unsigned i = 0; i < avf->nb_streams; ++i)
@@ -191,11 +295,21 @@ static int open_slave(AVFormatContext *avf, char *slave, TeeSlave *tee_slave)
                    av_log(avf, AV_LOG_ERROR, "Invalid onfail option value, "
                           "valid options are 'abort' and 'ignore'\n"););
     PROCESS_OPTION("use_fifo",
-                   parse_slave_fifo_policy(value, tee_slave),
+                   parse_slave_bool_option(value, &tee_slave->use_fifo),
                    av_log(avf, AV_LOG_ERROR, "Error parsing fifo options: %s\n",
                           av_err2str(ret)););
     PROCESS_OPTION("fifo_options",
                    parse_slave_fifo_options(value, tee_slave), ;);
+    PROCESS_OPTION("async",
+                   parse_slave_bool_option(value, &tee_slave->async),
+                   av_log(avf, AV_LOG_ERROR, "Invalid async option value\n"););
+    PROCESS_OPTION("queue_size",
+                   parse_slave_queue_size(value, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid queue_size option value\n"););
+    PROCESS_OPTION("onfull",
+                   parse_slave_full_policy_option(value, tee_slave),
+                   av_log(avf, AV_LOG_ERROR, "Invalid onfull option value, "
+                          "valid options are 'block' and 'drop'\n"););
     entry = NULL;
     while ((entry = av_dict_get(options, "bsfs", entry, AV_DICT_IGNORE_SUFFIX))) {
         /* trim out strlen("bsfs") characters from key */
@@ -424,6 +538,162 @@ static void log_slave(TeeSlave *slave, void *log_ctx, int log_level)
     }
 }
 
+/**
+ * Send a packet through the bitstream filters of a slave and write the
+ * result, or flush the slave if pkt is NULL. The packet must be a new
+ * reference with the slave's stream index, it is unreferenced.
+ */
+static int write_slave_packet(void *log_ctx, TeeSlave *tee_slave, AVPacket *pkt)
+{
+    AVFormatContext *avf2 = tee_slave->avf;
+    AVBSFContext *bsfs;
+    int ret, s2;
+
+    if (!pkt)
+        return av_interleaved_write_frame(avf2, NULL);
+
+    s2 = pkt->stream_index;
+    bsfs = tee_slave->bsfs[s2];
+
+    ret = av_bsf_send_packet(bsfs, pkt);
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        av_log(log_ctx, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
+               av_err2str(ret));
+        return ret;
+    }
+
+    while(1) {
+        ret = av_bsf_receive_packet(bsfs, pkt);
+        if (ret == AVERROR(EAGAIN)) {
+            ret = 0;
+            break;
+        } else if (ret < 0) {
+            break;
+        }
+
+        av_packet_rescale_ts(pkt, bsfs->time_base_out,
+                             avf2->streams[s2]->time_base);
+        ret = av_interleaved_write_frame(avf2, pkt);
+        if (ret < 0)
+            break;
+    };
+    return ret;
+}
+
+static void free_message(void *msg)
+{
+    TeeMessage *tee_msg = msg;
+    av_packet_free(&tee_msg->pkt);
+}
+
+#if HAVE_THREADS
+static void *slave_writer_thread(void *arg)
+{
+    TeeSlave *tee_slave = arg;
+    TeeMessage msg;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(tee_slave->queue, &msg, 0)) >= 0) {
+        const int flush = !msg.pkt;
+        int64_t latency;
+
+        ret = write_slave_packet(tee_slave->avf, tee_slave, msg.pkt);
+        free_message(&msg);
+        if (ret < 0)
+            break;
+
+        if (flush) {
+            ff_mutex_lock(&tee_slave->flush_lock);
+            tee_slave->nb_flushes_done++;
+            ff_cond_signal(&tee_slave->flush_cond);
+            ff_mutex_unlock(&tee_slave->flush_lock);
+            continue;
+        }
+
+        latency = av_gettime_relative() - msg.queued;
+        tee_slave->latency_sum += latency;
+        tee_slave->latency_max  = FFMAX(tee_slave->latency_max, latency);
+        tee_slave->nb_written++;
+    }
+
+    if (ret != AVERROR_EOF) {
+        tee_slave->thread_ret = ret;
+        /* make the muxing thread notice the failure on its next send */
+        av_thread_message_queue_set_err_send(tee_slave->queue, ret);
+    }
+
+    /* wake up a muxing thread waiting for a flush that will never happen */
+    ff_mutex_lock(&tee_slave->flush_lock);
+    tee_slave->thread_exited = 1;
+    ff_cond_signal(&tee_slave->flush_cond);
+    ff_mutex_unlock(&tee_slave->flush_lock);
+    return NULL;
+}
+#endif
+
+/**
+ * Wait until the writer thread has processed the flush request that was
+ * just queued, so that flushing the tee muxer flushes async slaves too.
+ */
+static int wait_slave_flush(TeeSlave *tee_slave)
+{
+    int ret = 0;
+
+    tee_slave->nb_flushes_sent++;
+    ff_mutex_lock(&tee_slave->flush_lock);
+    while (tee_slave->nb_flushes_done != tee_slave->nb_flushes_sent &&
+           !tee_slave->thread_exited)
+        ff_cond_wait(&tee_slave->flush_cond, &tee_slave->flush_lock);
+    if (tee_slave->nb_flushes_done != tee_slave->nb_flushes_sent)
+        ret = tee_slave->thread_ret;
+    ff_mutex_unlock(&tee_slave->flush_lock);
+    return ret;
+}
+
+/**
+ * Start a thread that writes the packets of a slave, so that a slow output
+ * does not stall the others. Packets are handed over through a bounded
+ * queue; when it is full, the muxing thread either blocks or drops the
+ * packet depending on the onfull slave option.
+ */
+static int start_slave_thread(AVFormatContext *avf, TeeSlave *tee_slave)
+{
+#if HAVE_THREADS
+    int ret;
+
+    tee_slave->wait_keyframe = av_calloc(avf->nb_streams, sizeof(*tee_slave->wait_keyframe));
+    if (!tee_slave->wait_keyframe)
+        return AVERROR(ENOMEM);
+
+    ret = av_thread_message_queue_alloc(&tee_slave->queue, tee_slave->queue_size,
+                                        sizeof(TeeMessage));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(tee_slave->queue, free_message);
+
+    if ((ret = ff_mutex_init(&tee_slave->flush_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_cond_init(&tee_slave->flush_cond, NULL))) {
+        ff_mutex_destroy(&tee_slave->flush_lock);
+        return AVERROR(ret);
+    }
+    tee_slave->flush_sync_init = 1;
+
+    ret = pthread_create(&tee_slave->thread, NULL, slave_writer_thread, tee_slave);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "Failed to start thread: %s\n",
+               av_err2str(AVERROR(ret)));
+        return AVERROR(ret);
+    }
+    tee_slave->thread_started = 1;
+    return 0;
+#else
+    av_log(avf, AV_LOG_ERROR, "Async slaves require threading support\n");
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static int tee_process_slave_failure(AVFormatContext *avf, unsigned slave_idx, int err_n)
 {
     TeeContext *tee = avf->priv_data;
@@ -478,11 +748,16 @@ static int tee_write_header(AVFormatContext *avf)
     for (unsigned i = 0; i < nb_slaves; i++) {
 
         tee->slaves[i].use_fifo = tee->use_fifo;
+        tee->slaves[i].async = tee->async;
+        tee->slaves[i].queue_size = tee->queue_size;
+        tee->slaves[i].on_full = ON_SLAVE_FULL_BLOCK;
         ret = av_dict_copy(&tee->slaves[i].fifo_options, tee->fifo_options, 0);
         if (ret < 0)
             goto fail;
 
-        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0) {
+        if ((ret = open_slave(avf, slaves[i], &tee->slaves[i])) < 0 ||
+            (tee->slaves[i].async &&
+             (ret = start_slave_thread(avf, &tee->slaves[i])) < 0)) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (ret < 0)
                 goto fail;
@@ -537,62 +812,76 @@ static int tee_write_packet(AVFormatContext *avf, AVPacket *pkt)
     int s2;
 
     for (unsigned i = 0; i < tee->nb_slaves; i++) {
-        AVFormatContext *avf2 = tee->slaves[i].avf;
-        AVBSFContext *bsfs;
+        TeeSlave *tee_slave = &tee->slaves[i];
+        AVPacket *src = pkt2;
 
-        if (!avf2)
+        if (!tee_slave->avf)
             continue;
 
-        /* Flush slave if pkt is NULL*/
-        if (!pkt) {
-            ret = av_interleaved_write_frame(avf2, NULL);
-            if (ret < 0) {
-                ret = tee_process_slave_failure(avf, i, ret);
-                if (!ret_all && ret < 0)
-                    ret_all = ret;
-            }
-            continue;
-        }
+        if (pkt) {
+            s = pkt->stream_index;
+            s2 = tee_slave->stream_map[s];
+            if (s2 < 0)
+                continue;
 
-        s = pkt->stream_index;
-        s2 = tee->slaves[i].stream_map[s];
-        if (s2 < 0)
-            continue;
+            if (tee_slave->queue) {
+                if (tee_slave->wait_keyframe[s]) {
+                    if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+                        tee_slave->nb_dropped++;
+                        continue;
+                    }
+                    tee_slave->wait_keyframe[s] = 0;
+                }
+                src = av_packet_alloc();
+                if (!src) {
+                    if (!ret_all)
+                        ret_all = AVERROR(ENOMEM);
+                    continue;
+                }
+            }
 
-        if ((ret = av_packet_ref(pkt2, pkt)) < 0) {
-            if (!ret_all)
-                ret_all = ret;
-            continue;
+            if ((ret = av_packet_ref(src, pkt)) < 0) {
+                if (src != pkt2)
+                    av_packet_free(&src);
+                if (!ret_all)
+                    ret_all = ret;
+                continue;
+            }
+            src->stream_index = s2;
+        } else {
+            /* Flush slave if pkt is NULL*/
+            src = NULL;
         }
-        bsfs = tee->slaves[i].bsfs[s2];
-        pkt2->stream_index = s2;
 
-        ret = av_bsf_send_packet(bsfs, pkt2);
-        if (ret < 0) {
-            av_packet_unref(pkt2);
-            av_log(avf, AV_LOG_ERROR, "Error while sending packet to bitstream filter: %s\n",
-                   av_err2str(ret));
-            ret = tee_process_slave_failure(avf, i, ret);
-            if (!ret_all && ret < 0)
-                ret_all = ret;
-        }
+        if (tee_slave->queue) {
+            TeeMessage msg = { .pkt = src, .queued = av_gettime_relative() };
+            int drop = src && tee_slave->on_full == ON_SLAVE_FULL_DROP;
 
-        while(1) {
-            ret = av_bsf_receive_packet(bsfs, pkt2);
+            ret = av_thread_message_queue_send(tee_slave->queue, &msg,
+                                               drop ? AV_THREAD_MESSAGE_NONBLOCK : 0);
             if (ret == AVERROR(EAGAIN)) {
-                ret = 0;
-                break;
+                if (!tee_slave->nb_dropped)
+                    av_log(avf, AV_LOG_WARNING, "Slave muxer #%u queue full, "
+                           "dropping packets\n", i);
+                tee_slave->nb_dropped++;
+                tee_slave->wait_keyframe[s] = 1;
+                av_packet_free(&src);
+                continue;
+            } else if (ret >= 0 && !src) {
+                ret = wait_slave_flush(tee_slave);
             } else if (ret < 0) {
-                break;
+                av_packet_free(&src);
             }
+            if (ret < 0) {
+                /* the writer thread has failed */
+                ret = tee_process_slave_failure(avf, i, ret);
+                if (!ret_all && ret < 0)
+                    ret_all = ret;
+            }
+            continue;
+        }
 
-            av_packet_rescale_ts(pkt2, bsfs->time_base_out,
-                                 avf2->streams[s2]->time_base);
-            ret = av_interleaved_write_frame(avf2, pkt2);
-            if (ret < 0)
-                break;
-        };
-
+        ret = write_slave_packet(avf, tee_slave, src);
         if (ret < 0) {
             ret = tee_process_slave_failure(avf, i, ret);
             if (!ret_all && ret < 0)
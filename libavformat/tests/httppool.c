@@ -0,0 +1,253 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Exercise the HTTP connection pool against a minimal keep-alive HTTP
+ * server running on a loopback socket, and report how many connections
+ * the server had to accept for each request.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavformat/avformat.h"
+#include "libavformat/httppool.h"
+#include "libavformat/network.h"
+
+#define MAX_CONNECTIONS 16
+#define LARGE_SIZE      100000
+
+static int listen_fd;
+static int server_port;
+static atomic_int stop;
+static atomic_int nb_accepted;
+static pthread_t conn_threads[MAX_CONNECTIONS];
+static char large[LARGE_SIZE];
+
+static int send_all(int fd, const char *buf, int size)
+{
+    while (size > 0) {
+        int n = send(fd, buf, size, 0);
+        if (n <= 0)
+            return -1;
+        buf  += n;
+        size -= n;
+    }
+    return 0;
+}
+
+/* Answer GET requests on one connection until the client closes it.
+ * /large returns a body bigger than an AVIOContext buffer, /close asks the
+ * client to close the connection, anything else returns a short text. */
+static void *serve_connection(void *arg)
+{
+    int fd = (intptr_t)arg;
+    char req[2048] = "", path[256], head[256];
+    int len = 0;
+
+    for (;;) {
+        char *end, body[300];
+        const char *data = body;
+        int body_size, close_conn, n;
+
+        while (!(end = strstr(req, "\r\n\r\n"))) {
+            if (len >= sizeof(req) - 1)
+                goto done;
+            n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+            if (n <= 0)
+                goto done;
+            len += n;
+            req[len] = 0;
+        }
+        if (sscanf(req, "GET %255s", path) != 1)
+            goto done;
+
+        close_conn = !strcmp(path, "/close");
+        if (!strcmp(path, "/large")) {
+            data      = large;
+            body_size = sizeof(large);
+        } else {
+            body_size = snprintf(body, sizeof(body), "hello from %s", path);
+        }
+        n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\n"
+                     "Content-Length: %d\r\n%s\r\n",
+                     body_size, close_conn ? "Connection: close\r\n" : "");
+        if (send_all(fd, head, n) < 0 || send_all(fd, data, body_size) < 0 ||
+            close_conn)
+            goto done;
+
+        end += 4;
+        len -= end - req;
+        memmove(req, end, len + 1);
+    }
+done:
+    closesocket(fd);
+    return NULL;
+}
+
+static void *server_thread(void *arg)
+{
+    while (!atomic_load(&stop)) {
+        struct pollfd p = { listen_fd, POLLIN, 0 };
+        int fd, n;
+
+        if (poll(&p, 1, 50) <= 0)
+            continue;
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        n = atomic_load(&nb_accepted);
+        if (n == MAX_CONNECTIONS ||
+            pthread_create(&conn_threads[n], NULL, serve_connection, (void *)(intptr_t)fd)) {
+            closesocket(fd);
+            continue;
+        }
+        atomic_fetch_add(&nb_accepted, 1);
+    }
+    return NULL;
+}
+
+static int start_server(pthread_t *thread)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(listen_fd, 8) ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len))
+        return -1;
+    server_port = ntohs(addr.sin_port);
+    return pthread_create(thread, NULL, server_thread, NULL) ? -1 : 0;
+}
+
+static AVIOContext *open_path(HTTPPool *pool, const char *path)
+{
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    char url[256];
+    int ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d%s", server_port, path);
+    ret = ff_http_pool_open(pool, &pb, url, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        printf("%s: open failed: %s\n", path, av_err2str(ret));
+    return pb;
+}
+
+/* Read at most max_read bytes of the response, all of it if max_read is 0. */
+static int read_body(AVIOContext *pb, int max_read)
+{
+    uint8_t buf[4096];
+    int total = 0;
+
+    while (!max_read || total < max_read) {
+        int n = avio_read(pb, buf, max_read ? FFMIN(max_read - total, sizeof(buf)) : sizeof(buf));
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+static void fetch(HTTPPool *pool, const char *path, int max_read)
+{
+    AVIOContext *pb = open_path(pool, path);
+    int total;
+
+    if (!pb)
+        return;
+    total = read_body(pb, max_read);
+    ff_http_pool_release(pool, &pb);
+    printf("%s: read %d bytes, %d connection(s) accepted\n",
+           path, total, atomic_load(&nb_accepted));
+}
+
+int main(void)
+{
+    AVFormatContext *s;
+    HTTPPool *pool;
+    AVIOContext *pb1, *pb2;
+    pthread_t thread;
+
+    avformat_network_init();
+    memset(large, 'x', sizeof(large));
+    if (start_server(&thread) < 0) {
+        printf("Failed to start the test server\n");
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_WARNING);
+    s = avformat_alloc_context();
+    if (s)
+        s->url = av_strdup("");
+    pool = s && s->url ? ff_http_pool_alloc(s, 1) : NULL;
+    if (!pool) {
+        printf("Allocation failed\n");
+        return 1;
+    }
+
+    printf("Sequential requests reuse the connection:\n");
+    fetch(pool, "/a", 0);
+    fetch(pool, "/b", 0);
+
+    printf("A partially read response is not reused:\n");
+    fetch(pool, "/large", 16);
+    fetch(pool, "/c", 0);
+
+    printf("A response closing the connection is not reused:\n");
+    fetch(pool, "/close", 0);
+    fetch(pool, "/d", 0);
+
+    printf("Only max_idle connections are kept:\n");
+    for (int i = 0; i < 2; i++) {
+        const char *path1 = i ? "/g" : "/e", *path2 = i ? "/h" : "/f";
+
+        pb1 = open_path(pool, path1);
+        pb2 = open_path(pool, path2);
+        if (pb1)
+            read_body(pb1, 0);
+        if (pb2)
+            read_body(pb2, 0);
+        ff_http_pool_release(pool, &pb1);
+        ff_http_pool_release(pool, &pb2);
+        printf("%s and %s at once: %d connection(s) accepted\n",
+               path1, path2, atomic_load(&nb_accepted));
+    }
+
+    ff_http_pool_free(&pool);
+    avformat_free_context(s);
+
+    atomic_store(&stop, 1);
+    pthread_join(thread, NULL);
+    for (int i = 0; i < atomic_load(&nb_accepted); i++)
+        pthread_join(conn_threads[i], NULL);
+    closesocket(listen_fd);
+    avformat_network_deinit();
+    return 0;
+}
@@ -46,6 +46,7 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int max_buffer_size;        /**< if non zero, the read buffer may grow up to this size for sequential reads */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -85,10 +85,24 @@ typedef struct BufferPoolEntry {
     AVBuffer buffer;
 } BufferPoolEntry;
 
+/**
+ * Number of entries that can be returned to and taken from a pool without
+ * taking its mutex.
+ */
+#define BUFFER_POOL_CACHE_SIZE 4
+
 struct AVBufferPool {
     AVMutex mutex;
     BufferPoolEntry *pool;
 
+    /*
+     * Lock-free cache of free entries, checked before the mutex-protected
+     * list. Each slot holds either 0 or a BufferPoolEntry pointer, and is
+     * only ever taken with an atomic exchange, so an entry can never be
+     * claimed twice.
+     */
+    atomic_uintptr_t cache[BUFFER_POOL_CACHE_SIZE];
+
     /*
      * This is used to track when the pool is to be freed.
      * The pointer to the pool itself held by the caller is considered to
@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #include "mem.h"
@@ -46,21 +47,31 @@
 typedef struct ThreadInfo {
     AVExecutor *e;
     ExecutorThread thread;
+
+    AVMutex lock;               ///< protects tasks
+    AVTask *tasks;              ///< local queue, sorted by priority
 } ThreadInfo;
 
 struct AVExecutor {
     AVTaskCallbacks cb;
-    int thread_count;
+    int thread_count;           ///< final number of workers, set before any of them starts
+    int nb_started;             ///< number of workers that were actually started
     bool recursive;
 
     ThreadInfo *threads;
     uint8_t *local_contexts;
+    int nb_queue_locks;
 
+    /* only used to let idle workers sleep */
     AVMutex lock;
     AVCond cond;
-    int die;
+    atomic_int die;
 
-    AVTask *tasks;
+    atomic_uint task_seq;       ///< bumped by every av_executor_execute() call
+    atomic_int  nb_sleeping;    ///< number of workers waiting on cond
+    atomic_uint next_queue;     ///< queue for the next task added by a non-worker thread
+
+    AVTask *tasks;              ///< task queue when there are no worker threads
 };
 
 static AVTask* remove_task(AVTask **prev, AVTask *t)
@@ -76,58 +87,110 @@ static void add_task(AVTask **prev, AVTask *t)
     *prev   = t;
 }
 
+static void add_task_sorted(const AVTaskCallbacks *cb, AVTask **prev, AVTask *t)
+{
+    for (; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
+        /* nothing */;
+    add_task(prev, t);
+}
+
+// remove the highest priority task that is ready to run
+static AVTask *get_ready_task(const AVTaskCallbacks *cb, AVTask **prev)
+{
+    for (; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
+        /* nothing */;
+    return *prev ? remove_task(prev, *prev) : NULL;
+}
+
 static int run_one_task(AVExecutor *e, void *lc)
 {
     AVTaskCallbacks *cb = &e->cb;
-    AVTask **prev;
+    AVTask *t = get_ready_task(cb, &e->tasks);
 
-    for (prev = &e->tasks; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
-        /* nothing */;
-    if (*prev) {
-        AVTask *t = remove_task(prev, *prev);
-        if (e->thread_count > 0)
-            ff_mutex_unlock(&e->lock);
+    if (t) {
         cb->run(t, lc, cb->user_data);
-        if (e->thread_count > 0)
-            ff_mutex_lock(&e->lock);
         return 1;
     }
     return 0;
 }
 
 #if HAVE_THREADS
+static AVTask *take_task(ThreadInfo *ti)
+{
+    AVTask *t;
+
+    ff_mutex_lock(&ti->lock);
+    t = get_ready_task(&ti->e->cb, &ti->tasks);
+    ff_mutex_unlock(&ti->lock);
+
+    return t;
+}
+
+#if HAVE_THREAD_LOCAL
+// the worker running on this thread, NULL on non-worker threads
+static _Thread_local ThreadInfo *worker_self;
+#endif
+
+static ThreadInfo *current_worker(const AVExecutor *e)
+{
+#if HAVE_THREAD_LOCAL
+    ThreadInfo *ti = worker_self;
+    if (ti && ti->e == e)
+        return ti;
+#endif
+    return NULL;
+}
+
 static void *executor_worker_task(void *data)
 {
     ThreadInfo *ti = (ThreadInfo*)data;
     AVExecutor *e  = ti->e;
-    void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
+    const int self = ti - e->threads;
+    void *lc       = e->local_contexts + self * e->cb.local_context_size;
 
-    ff_mutex_lock(&e->lock);
-    while (1) {
-        if (e->die) break;
+#if HAVE_THREAD_LOCAL
+    worker_self = ti;
+#endif
 
-        if (!run_one_task(e, lc)) {
-            //no task in one loop
-            ff_cond_wait(&e->cond, &e->lock);
+    while (!atomic_load(&e->die)) {
+        const unsigned seq = atomic_load(&e->task_seq);
+        AVTask *t = take_task(ti);
+
+        // local queue is empty or nothing in it is ready, steal from the others
+        for (int i = 1; !t && i < e->thread_count; i++)
+            t = take_task(&e->threads[(self + i) % e->thread_count]);
+
+        if (t) {
+            e->cb.run(t, lc, e->cb.user_data);
+            continue;
         }
+
+        ff_mutex_lock(&e->lock);
+        atomic_fetch_add(&e->nb_sleeping, 1);
+        // sleep only if nothing was added since the queues were scanned
+        if (!atomic_load(&e->die) && atomic_load(&e->task_seq) == seq)
+            ff_cond_wait(&e->cond, &e->lock);
+        atomic_fetch_sub(&e->nb_sleeping, 1);
+        ff_mutex_unlock(&e->lock);
     }
-    ff_mutex_unlock(&e->lock);
     return NULL;
 }
 #endif
 
 static void executor_free(AVExecutor *e, const int has_lock, const int has_cond)
 {
-    if (e->thread_count) {
+    if (e->nb_started) {
         //signal die
         ff_mutex_lock(&e->lock);
-        e->die = 1;
+        atomic_store(&e->die, 1);
         ff_cond_broadcast(&e->cond);
         ff_mutex_unlock(&e->lock);
 
-        for (int i = 0; i < e->thread_count; i++)
+        for (int i = 0; i < e->nb_started; i++)
             executor_thread_join(e->threads[i].thread, NULL);
     }
+    for (int i = 0; i < e->nb_queue_locks; i++)
+        ff_mutex_destroy(&e->threads[i].lock);
     if (has_cond)
         ff_cond_destroy(&e->cond);
     if (has_lock)
@@ -151,6 +214,11 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
         return NULL;
     e->cb = *cb;
 
+    atomic_init(&e->die, 0);
+    atomic_init(&e->task_seq, 0);
+    atomic_init(&e->nb_sleeping, 0);
+    atomic_init(&e->next_queue, 0);
+
     e->local_contexts = av_calloc(FFMAX(thread_count, 1), e->cb.local_context_size);
     if (!e->local_contexts)
         goto free_executor;
@@ -159,7 +227,8 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
     if (!e->threads)
         goto free_executor;
 
-    if (!thread_count)
+    // without thread support all tasks are run by av_executor_execute()
+    if (!thread_count || !HAVE_THREADS)
         return e;
 
     has_lock = !ff_mutex_init(&e->lock, NULL);
@@ -168,9 +237,18 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
     if (!has_lock || !has_cond)
         goto free_executor;
 
-    for (/* nothing */; e->thread_count < thread_count; e->thread_count++) {
-        ThreadInfo *ti = e->threads + e->thread_count;
+    // all queues must exist before the first worker may steal from them
+    for (/* nothing */; e->nb_queue_locks < thread_count; e->nb_queue_locks++) {
+        ThreadInfo *ti = e->threads + e->nb_queue_locks;
         ti->e = e;
+        if (ff_mutex_init(&ti->lock, NULL))
+            goto free_executor;
+    }
+
+    // workers read thread_count, so it must not change once they run
+    e->thread_count = thread_count;
+    for (/* nothing */; e->nb_started < thread_count; e->nb_started++) {
+        ThreadInfo *ti = e->threads + e->nb_started;
         if (executor_thread_create(&ti->thread, NULL, executor_worker_task, ti))
             goto free_executor;
     }
@@ -195,27 +273,38 @@ void av_executor_free(AVExecutor **executor)
 void av_executor_execute(AVExecutor *e, AVTask *t)
 {
     AVTaskCallbacks *cb = &e->cb;
-    AVTask **prev;
 
-    if (e->thread_count)
-        ff_mutex_lock(&e->lock);
-    if (t) {
-        for (prev = &e->tasks; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
-            /* nothing */;
-        add_task(prev, t);
-    }
+#if HAVE_THREADS
     if (e->thread_count) {
-        ff_cond_signal(&e->cond);
-        ff_mutex_unlock(&e->lock);
-    }
+        if (t) {
+            // tasks added by a task stay on its worker, others are spread
+            ThreadInfo *ti = current_worker(e);
+            if (!ti)
+                ti = e->threads + atomic_fetch_add(&e->next_queue, 1) % e->thread_count;
+
+            ff_mutex_lock(&ti->lock);
+            add_task_sorted(cb, &ti->tasks, t);
+            ff_mutex_unlock(&ti->lock);
+        }
 
-    if (!e->thread_count || !HAVE_THREADS) {
-        if (e->recursive)
-            return;
-        e->recursive = true;
-        // We are running in a single-threaded environment, so we must handle all tasks ourselves
-        while (run_one_task(e, e->local_contexts))
-            /* nothing */;
-        e->recursive = false;
+        atomic_fetch_add(&e->task_seq, 1);
+        if (atomic_load(&e->nb_sleeping)) {
+            ff_mutex_lock(&e->lock);
+            ff_cond_signal(&e->cond);
+            ff_mutex_unlock(&e->lock);
+        }
+        return;
     }
+#endif
+
+    if (t)
+        add_task_sorted(cb, &e->tasks, t);
+
+    if (e->recursive)
+        return;
+    e->recursive = true;
+    // We are running in a single-threaded environment, so we must handle all tasks ourselves
+    while (run_one_task(e, e->local_contexts))
+        /* nothing */;
+    e->recursive = false;
 }
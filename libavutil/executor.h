@@ -59,6 +59,12 @@ void av_executor_free(AVExecutor **e);
 
 /**
  * Add task to executor
+ *
+ * Every worker thread has its own task queue ordered by priority. Tasks added
+ * from a running task go to the queue of the current worker if the compiler
+ * supports thread-local storage, others are distributed over all workers.
+ * Idle workers steal ready tasks from the other queues.
+ *
  * @param e pointer to executor
  * @param t pointer to task. If NULL, it will wakeup one work thread
  */
@@ -0,0 +1,136 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks that buffers handed out by an AVBufferPool are
+ * never shared between concurrent users. When called with arguments, it
+ * instead measures get/release throughput:
+ *
+ *     buffer <max threads> [iterations per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS 64
+#define BUF_SIZE    1024
+#define BUF_HELD    3
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int check;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *arg)
+{
+    ThreadArg *t = arg;
+    AVBufferRef *bufs[BUF_HELD];
+
+    for (int i = 0; i < t->iterations; i++) {
+        for (int j = 0; j < BUF_HELD; j++) {
+            bufs[j] = av_buffer_pool_get(t->pool);
+            if (!bufs[j]) {
+                t->errors++;
+                return NULL;
+            }
+            if (t->check)
+                memset(bufs[j]->data, t->id * BUF_HELD + j, BUF_SIZE);
+        }
+        for (int j = 0; j < BUF_HELD; j++) {
+            if (t->check) {
+                for (int k = 0; k < BUF_SIZE; k++) {
+                    if (bufs[j]->data[k] != (uint8_t)(t->id * BUF_HELD + j)) {
+                        t->errors++;
+                        break;
+                    }
+                }
+            }
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static int run(int nb_threads, int iterations, int check)
+{
+    ThreadArg args[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    AVBufferPool *pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    int errors = 0;
+
+    if (!pool)
+        return -1;
+
+    for (int i = 0; i < nb_threads; i++) {
+        args[i] = (ThreadArg) {
+            .pool       = pool,
+            .id         = i,
+            .iterations = iterations,
+            .check      = check,
+        };
+        if (pthread_create(&threads[i], NULL, thread_main, &args[i])) {
+            fprintf(stderr, "pthread_create failed.\n");
+            nb_threads = i;
+            errors++;
+            break;
+        }
+    }
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads, iterations;
+
+    if (argc < 2) {
+        int errors = 0;
+        for (int nb_threads = 1; nb_threads <= 8; nb_threads *= 2)
+            errors += run(nb_threads, 2000, 1);
+        return !!errors;
+    }
+
+    max_threads = av_clip(atoi(argv[1]), 1, MAX_THREADS);
+    iterations  = argc > 2 ? atoi(argv[2]) : 1000000;
+
+    for (int nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+        int64_t t = av_gettime_relative();
+        if (run(nb_threads, iterations, 0))
+            return 1;
+        t = av_gettime_relative() - t;
+        printf("%2d threads: %8.2f Mops/s\n", nb_threads,
+               2.0 * BUF_HELD * iterations * nb_threads / FFMAX(t, 1));
+    }
+
+    return 0;
+}
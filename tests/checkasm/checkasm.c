@@ -241,8 +241,11 @@ static const struct {
         { "vorbisdsp", checkasm_check_vorbisdsp },
     #endif
     #if CONFIG_VVC_DECODER
-        { "vvc_alf", checkasm_check_vvc_alf },
-        { "vvc_mc",  checkasm_check_vvc_mc  },
+        { "vvc_alf",      checkasm_check_vvc_alf      },
+        { "vvc_lmcs",     checkasm_check_vvc_lmcs     },
+        { "vvc_mc",       checkasm_check_vvc_mc       },
+        { "vvc_residual", checkasm_check_vvc_residual },
+        { "vvc_sao",      checkasm_check_vvc_sao      },
     #endif
 #endif
 #if CONFIG_AVFILTER
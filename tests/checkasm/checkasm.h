@@ -141,7 +141,10 @@ void checkasm_check_vp9dsp(void);
 void checkasm_check_videodsp(void);
 void checkasm_check_vorbisdsp(void);
 void checkasm_check_vvc_alf(void);
+void checkasm_check_vvc_lmcs(void);
 void checkasm_check_vvc_mc(void);
+void checkasm_check_vvc_residual(void);
+void checkasm_check_vvc_sao(void);
 
 struct CheckasmPerf;
 
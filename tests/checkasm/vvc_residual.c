@@ -0,0 +1,95 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavcodec/vvc/ctu.h"
+#include "libavcodec/vvc/dsp.h"
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+static const uint32_t pixel_mask[3] = { 0xffffffff, 0x03ff03ff, 0x0fff0fff };
+
+#define SIZEOF_PIXEL ((bit_depth + 7) / 8)
+#define PIXEL_STRIDE (MAX_TB_SIZE + 16)
+#define BUF_SIZE (PIXEL_STRIDE * MAX_TB_SIZE * 2)
+
+#define randomize_buffers(buf0, buf1, size)                 \
+    do {                                                    \
+        uint32_t mask = pixel_mask[(bit_depth - 8) >> 1];   \
+        int k;                                              \
+        for (k = 0; k < size; k += 4) {                     \
+            uint32_t r = rnd() & mask;                      \
+            AV_WN32A(buf0 + k, r);                          \
+            AV_WN32A(buf1 + k, r);                          \
+        }                                                   \
+    } while (0)
+
+static void randomize_residuals(int *res, const int size, const int bit_depth)
+{
+    // Keep most residuals in the transform range, and put a few far outside of it
+    // to exercise the saturation.
+    const int range = 1 << (bit_depth + 1);
+    for (int k = 0; k < size; k++) {
+        const int r = rnd();
+        if (!(r & 0xff))
+            res[k] = (r & 0x100) ? INT16_MAX * 4 : INT16_MIN * 4;
+        else
+            res[k] = (int)(rnd() % (2 * range)) - range;
+    }
+}
+
+static void check_add_residual(VVCDSPContext *c, const int bit_depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(int, res, [MAX_TB_SIZE * MAX_TB_SIZE]);
+    const ptrdiff_t stride = PIXEL_STRIDE * SIZEOF_PIXEL;
+
+    declare_func(void, uint8_t *dst, const int *res, int width, int height, ptrdiff_t stride);
+
+    for (int log2_h = 1; log2_h <= 6; log2_h++) {
+        for (int log2_w = 1; log2_w <= 6; log2_w++) {
+            const int w = 1 << log2_w;
+            const int h = 1 << log2_h;
+            if (check_func(c->itx.add_residual, "vvc_add_residual_%dx%d_%d", w, h, bit_depth)) {
+                randomize_buffers(dst0, dst1, BUF_SIZE);
+                randomize_residuals(res, w * h, bit_depth);
+                call_ref(dst0, res, w, h, stride);
+                call_new(dst1, res, w, h, stride);
+                if (memcmp(dst0, dst1, BUF_SIZE))
+                    fail();
+                if (w == h)
+                    bench_new(dst1, res, w, h, stride);
+            }
+        }
+    }
+}
+
+void checkasm_check_vvc_residual(void)
+{
+    VVCDSPContext h;
+
+    for (int bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        ff_vvc_dsp_init(&h, bit_depth);
+        check_add_residual(&h, bit_depth);
+    }
+    report("add_residual");
+}
@@ -2,6 +2,11 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_HTTPPOOL-$(call ALLYES, HTTP_PROTOCOL HLS_DEMUXER) += fate-httppool
+FATE_LIBAVFORMAT-$(HAVE_THREADS) += $(FATE_HTTPPOOL-yes)
+fate-httppool: libavformat/tests/httppool$(EXESUF)
+fate-httppool: CMD = run libavformat/tests/httppool$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
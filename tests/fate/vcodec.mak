@@ -345,6 +345,13 @@ fate-vsynth%-msrle:              CODEC   = msrle
 FATE_VCODEC_SCALE-$(call ENCDEC, PNG, AVI) += mpng
 fate-vsynth%-mpng:               CODEC   = png
 
+# deflate in independent chunks on several slice threads, only run on the
+# generated vsynth inputs
+FATE_VCODEC_PNG_CHUNKED-$(call ENCDEC, PNG, AVI, SCALE_FILTER) += mpng-chunked
+fate-vsynth%-mpng-chunked:       CODEC   = png
+fate-vsynth%-mpng-chunked:       ENCOPTS = -thread_type slice -threads 4 \
+                                           -deflate_chunk_size 65536
+
 FATE_VCODEC_SCALE-$(call ENCDEC, MSVIDEO1, AVI) += msvideo1
 
 FATE_VCODEC_SCALE-$(call ENCDEC, PRORES, MOV) += prores prores_int prores_444 prores_444_int prores_ks
@@ -493,6 +500,11 @@ VSYNTH3_OFF  = $(RESIZE_OFF) $(INC_PAR_OFF)
 FATE_VCODEC3 = $(filter-out $(VSYNTH3_OFF),$(FATE_VCODEC))
 FATE_VSYNTH3 = $(FATE_VCODEC3:%=fate-vsynth3-%)
 
+FATE_VCODEC_PNG_CHUNKED := $(if $(call ENCDEC, RAWVIDEO, RAWVIDEO),$(FATE_VCODEC_PNG_CHUNKED-yes))
+FATE_VSYNTH1 += $(FATE_VCODEC_PNG_CHUNKED:%=fate-vsynth1-%)
+FATE_VSYNTH2 += $(FATE_VCODEC_PNG_CHUNKED:%=fate-vsynth2-%)
+FATE_VSYNTH3 += $(FATE_VCODEC_PNG_CHUNKED:%=fate-vsynth3-%)
+
 $(FATE_VSYNTH1): tests/data/vsynth1.yuv
 $(FATE_VSYNTH2): tests/data/vsynth2.yuv
 $(FATE_VSYNTH_LENA): tests/data/vsynth_lena.yuv
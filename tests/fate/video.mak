@@ -260,6 +260,10 @@ fate-mjpegb: CMD = framecrc -idct simple -fflags +bitexact -i $(TARGET_SAMPLES)/
 FATE_VIDEO-$(call FRAMECRC, AVI, MJPEG) += fate-mjpeg-ticket3229
 fate-mjpeg-ticket3229: CMD = framecrc -idct simple -fflags +bitexact -i $(TARGET_SAMPLES)/mjpeg/mjpeg_field_order.avi -an
 
+FATE_VIDEO-$(call FRAMECRC, AVI, MJPEG) += fate-mjpeg-ticket3229-frame-threads
+fate-mjpeg-ticket3229-frame-threads: CMD = framecrc -threads 4 -thread_type frame -idct simple -fflags +bitexact -i $(TARGET_SAMPLES)/mjpeg/mjpeg_field_order.avi -an
+fate-mjpeg-ticket3229-frame-threads: REF = $(SRC_PATH)/tests/ref/fate/mjpeg-ticket3229
+
 FATE_VIDEO-$(call FRAMECRC, MVI, MOTIONPIXELS, SCALE_FILTER) += fate-motionpixels
 fate-motionpixels: CMD = framecrc -i $(TARGET_SAMPLES)/motion-pixels/INTRO-partial.MVI -an -pix_fmt rgb24 -frames:v 111 -vf scale
 
@@ -324,6 +328,10 @@ fate-sp5x: CMD = framecrc -idct simple -i $(TARGET_SAMPLES)/sp5x/sp5x_problem.av
 FATE_VIDEO-$(call FRAMECRC, THP, THP) += fate-thp
 fate-thp: CMD = framecrc -idct simple -i $(TARGET_SAMPLES)/thp/pikmin2-opening1-partial.thp -an
 
+FATE_VIDEO-$(call FRAMECRC, THP, THP) += fate-thp-frame-threads
+fate-thp-frame-threads: CMD = framecrc -threads 4 -thread_type frame -idct simple -i $(TARGET_SAMPLES)/thp/pikmin2-opening1-partial.thp -an
+fate-thp-frame-threads: REF = $(SRC_PATH)/tests/ref/fate/thp
+
 FATE_VIDEO-$(call FRAMECRC, TIERTEXSEQ, TIERTEXSEQVIDEO, SCALE_FILTER) += fate-tiertex-seq
 fate-tiertex-seq: CMD = framecrc -i $(TARGET_SAMPLES)/tiertex-seq/Gameover.seq -pix_fmt rgb24 -vf scale
 